@@ -0,0 +1,175 @@
+/*
+ * Copyright (C) 2011 Dmitry Marakasov
+ *
+ * This file is part of tspell.
+ *
+ * tspell is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * tspell is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with tspell.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef TSPELL_BKTREE_HH
+#define TSPELL_BKTREE_HH
+
+#include <algorithm>
+#include <vector>
+
+#include <stdint.h>
+
+#include <tspell/distance.hh>
+#include <tspell/matcher.hh>
+
+namespace TSpell {
+
+/*
+ * Burkhard-Keller tree
+ *
+ * Each node holds a key, and its children are labeled with distance
+ * from their keys to the node key. By triangle inequality, keys within
+ * distance d from the query may only be found under children labeled
+ * within d from the query-to-node distance.
+ *
+ * Restricted Damerau-Levenshtein distance used by the rest of tspell
+ * is not a metric, so the tree is built on unrestricted one, which
+ * is never larger; found keys are then checked with the restricted
+ * distance, so results match those of trie search.
+ */
+template<class Char>
+class BKTree {
+private:
+	struct Node {
+		uint32_t child;   /* first child, 0 if none */
+		uint32_t next;    /* next sibling, 0 if none */
+		uint32_t label;   /* distance to parent key */
+
+		Node(uint32_t l) : child(0), next(0), label(l) {
+		}
+	};
+
+private:
+	/* node i holds key i; keys are stored back to back in a single buffer */
+	std::vector<Node> nodes_;
+	std::vector<Char> chars_;
+	std::vector<uint32_t> offsets_;
+	std::vector<uint32_t> payloads_;
+
+	/* distance buffers for Insert */
+	DamerauScratch scratch_;
+
+private:
+	BKTree(const BKTree&);
+	BKTree& operator=(const BKTree&);
+
+private:
+	const Char* GetKey(uint32_t node) const {
+		return chars_.data() + offsets_[node];
+	}
+
+	size_t GetKeyLength(uint32_t node) const {
+		return offsets_[node + 1] - offsets_[node];
+	}
+
+public:
+	BKTree() : offsets_(1, 0) {
+	}
+
+	/* number of nodes, one per inserted key */
+	size_t GetSize() const {
+		return nodes_.size();
+	}
+
+	/* bytes of nodes, keys and distance buffers */
+	size_t GetMemoryUsage() const {
+		return nodes_.capacity() * sizeof(Node) +
+			chars_.capacity() * sizeof(Char) +
+			offsets_.capacity() * sizeof(uint32_t) +
+			payloads_.capacity() * sizeof(uint32_t) +
+			scratch_.lastrow.capacity() * sizeof(size_t) +
+			scratch_.matrix.capacity() * sizeof(int);
+	}
+
+	/*
+	 * Adds a key; unlike trie, the tree doesn't check for duplicate
+	 * keys, which would be reported once per insertion
+	 */
+	void Insert(const Char* string, size_t length, uint32_t payload) {
+		const uint32_t added = nodes_.size();
+
+		chars_.insert(chars_.end(), string, string + length);
+		offsets_.push_back(chars_.size());
+		payloads_.push_back(payload);
+
+		if (added == 0) {
+			nodes_.push_back(Node(0));
+			return;
+		}
+
+		uint32_t current = 0;
+		for (;;) {
+			const uint32_t label = DamerauDistance(string, length, GetKey(current), GetKeyLength(current), (int)(length + GetKeyLength(current)), scratch_);
+
+			uint32_t* link = &nodes_[current].child;
+			for (; *link != 0 && nodes_[*link].label != label; link = &nodes_[*link].next) {
+				/* empty */
+			}
+
+			if (*link == 0) {
+				*link = added;
+				nodes_.push_back(Node(label));
+				return;
+			}
+
+			current = *link;
+		}
+	}
+
+	/* passes every key within given distance to the appender, until it returns false */
+	template<class Appender>
+	void FindApprox(const Char* string, size_t length, int distance, Appender& appender) const {
+		if (nodes_.empty())
+			return;
+
+		const DistanceMatcher<Char> matcher(string, length);
+		DamerauScratch scratch;
+
+		std::vector<uint32_t> stack;
+		stack.reserve(64);
+		stack.push_back(0);
+
+		while (!stack.empty()) {
+			const uint32_t node = stack.back();
+			stack.pop_back();
+
+			/* children are only taken with labels within [nodedistance - distance,
+			 * nodedistance + distance], so distance beyond the largest label plus
+			 * distance doesn't need to be known exactly: no child passes anyway */
+			uint32_t maxlabel = 0;
+			for (uint32_t child = nodes_[node].child; child != 0; child = nodes_[child].next)
+				maxlabel = std::max(maxlabel, nodes_[child].label);
+
+			const int nodedistance = DamerauDistance(string, length, GetKey(node), GetKeyLength(node), distance + (int)maxlabel, scratch);
+
+			if (nodedistance <= distance && matcher.Distance(GetKey(node), GetKeyLength(node), distance) <= distance) {
+				if (!appender.Append(GetKey(node), GetKeyLength(node), payloads_[node]))
+					return;
+			}
+
+			for (uint32_t child = nodes_[node].child; child != 0; child = nodes_[child].next)
+				if ((int)nodes_[child].label >= nodedistance - distance && (int)nodes_[child].label <= nodedistance + distance)
+					stack.push_back(child);
+		}
+	}
+};
+
+}
+
+#endif
@@ -0,0 +1,254 @@
+/*
+ * Copyright (C) 2011 Dmitry Marakasov
+ *
+ * This file is part of tspell.
+ *
+ * tspell is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * tspell is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with tspell.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef TSPELL_DELETIONINDEX_HH
+#define TSPELL_DELETIONINDEX_HH
+
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+#include <stdint.h>
+
+#include <tspell/matcher.hh>
+
+namespace TSpell {
+
+/*
+ * Symmetric deletion index
+ *
+ * Any two strings within edit distance d (see BoundedDistance) may
+ * be reduced to the same string by removing at most d characters from
+ * each of them. So, all variants of every key with up to maxdistance
+ * characters removed are hashed into the index, and lookup generates
+ * the same variants for the query, collects keys found under their
+ * hashes and checks real distance to each of them.
+ *
+ * Lookups are much cheaper than trie search for small distances, at
+ * the cost of memory, which grows as (key length)^maxdistance.
+ */
+template<class Char>
+class DeletionIndex {
+private:
+	/* variant hash and the key it was produced from */
+	struct Entry {
+		uint32_t hash;
+		uint32_t key;
+
+		Entry(uint32_t h, uint32_t k) : hash(h), key(k) {
+		}
+
+		bool operator<(const Entry& other) const {
+			return hash < other.hash || (hash == other.hash && key < other.key);
+		}
+	};
+
+private:
+	const int maxdistance_;
+
+	/* keys are stored back to back in a single buffer */
+	std::vector<Char> chars_;
+	std::vector<uint32_t> offsets_;
+	std::vector<uint32_t> payloads_;
+
+	/* entries sorted by hash, bucketed by its upper bits */
+	std::vector<Entry> entries_;
+	std::vector<uint32_t> buckets_;
+	int shift_;
+
+	std::atomic<bool> frozen_;
+	std::mutex freeze_mutex_;
+
+private:
+	DeletionIndex(const DeletionIndex&);
+	DeletionIndex& operator=(const DeletionIndex&);
+
+private:
+	static uint32_t Hash(const Char* string, size_t length, size_t skip1, size_t skip2) {
+		/* FNV-1a */
+		uint32_t hash = 2166136261U;
+		for (size_t i = 0; i < length; ++i) {
+			if (i == skip1 || i == skip2)
+				continue;
+			hash = (hash ^ (uint32_t)string[i]) * 16777619U;
+		}
+		return hash;
+	}
+
+	/* hashes of all variants of the string with up to distance characters removed */
+	static void GetVariants(const Char* string, size_t length, int distance, std::vector<uint32_t>& hashes) {
+		static const size_t none = (size_t)-1;
+
+		hashes.clear();
+		hashes.push_back(Hash(string, length, none, none));
+
+		std::vector<Char> buffer;
+		for (size_t i = 0; distance > 0 && i < length; ++i) {
+			/* same variants are produced by removing any of repeated characters */
+			if (i > 0 && string[i] == string[i - 1])
+				continue;
+
+			hashes.push_back(Hash(string, length, i, none));
+
+			if (distance > 1) {
+				/* further deletions are done on the shortened string */
+				buffer.assign(string, string + length);
+				buffer.erase(buffer.begin() + i);
+				std::vector<uint32_t> subhashes;
+				GetVariants(buffer.data(), buffer.size(), distance - 1, subhashes);
+				hashes.insert(hashes.end(), subhashes.begin(), subhashes.end());
+			}
+		}
+
+		std::sort(hashes.begin(), hashes.end());
+		hashes.erase(std::unique(hashes.begin(), hashes.end()), hashes.end());
+	}
+
+	size_t Bucket(uint32_t hash) const {
+		return shift_ < 32 ? (hash >> shift_) : 0;
+	}
+
+	void DoFreeze() {
+		std::vector<uint32_t> hashes;
+
+		entries_.clear();
+		for (uint32_t key = 0; key < payloads_.size(); ++key) {
+			GetVariants(&chars_[offsets_[key]], offsets_[key + 1] - offsets_[key], maxdistance_, hashes);
+			for (std::vector<uint32_t>::const_iterator i = hashes.begin(); i != hashes.end(); ++i)
+				entries_.push_back(Entry(*i, key));
+		}
+
+		std::sort(entries_.begin(), entries_.end());
+
+		/* about one entry per bucket */
+		int bits = 0;
+		while (bits < 31 && ((size_t)1 << bits) < entries_.size())
+			++bits;
+		shift_ = 32 - bits;
+
+		buckets_.assign(((size_t)1 << bits) + 1, 0);
+		for (typename std::vector<Entry>::const_iterator i = entries_.begin(); i != entries_.end(); ++i)
+			++buckets_[Bucket(i->hash) + 1];
+		for (size_t i = 1; i < buckets_.size(); ++i)
+			buckets_[i] += buckets_[i - 1];
+	}
+
+	void EnsureFrozen() const {
+		if (!frozen_.load(std::memory_order_acquire))
+			const_cast<DeletionIndex*>(this)->Freeze();
+	}
+
+public:
+	DeletionIndex(int maxdistance) : maxdistance_(maxdistance), offsets_(1, 0), shift_(32), frozen_(false) {
+	}
+
+	int GetMaxDistance() const {
+		return maxdistance_;
+	}
+
+	/* number of inserted keys */
+	size_t GetSize() const {
+		return payloads_.size();
+	}
+
+	/* number of hashed variants of all keys */
+	size_t GetEntryCount() const {
+		EnsureFrozen();
+
+		return entries_.size();
+	}
+
+	size_t GetBucketCount() const {
+		EnsureFrozen();
+
+		return buckets_.empty() ? 0 : buckets_.size() - 1;
+	}
+
+	/* bytes of keys, entries and buckets */
+	size_t GetMemoryUsage() const {
+		return chars_.capacity() * sizeof(Char) +
+			offsets_.capacity() * sizeof(uint32_t) +
+			payloads_.capacity() * sizeof(uint32_t) +
+			entries_.capacity() * sizeof(Entry) +
+			buckets_.capacity() * sizeof(uint32_t);
+	}
+
+	/*
+	 * Adds a key; unlike trie, index doesn't check for duplicate keys,
+	 * which would be reported once per insertion
+	 */
+	void Insert(const Char* string, size_t length, uint32_t payload) {
+		chars_.insert(chars_.end(), string, string + length);
+		offsets_.push_back(chars_.size());
+		payloads_.push_back(payload);
+		frozen_ = false;
+	}
+
+	/* builds the index; done implicitly on first lookup after any insertion */
+	void Freeze() {
+		std::lock_guard<std::mutex> lock(freeze_mutex_);
+		if (!frozen_.load(std::memory_order_relaxed)) {
+			DoFreeze();
+			frozen_.store(true, std::memory_order_release);
+		}
+	}
+
+	/*
+	 * passes every key within given distance (no more than maxdistance)
+	 * to the appender, until it returns false
+	 */
+	template<class Appender>
+	void FindApprox(const Char* string, size_t length, int distance, Appender& appender) const {
+		EnsureFrozen();
+
+		std::vector<uint32_t> hashes;
+		GetVariants(string, length, std::min(distance, maxdistance_), hashes);
+
+		std::vector<uint32_t> candidates;
+		for (std::vector<uint32_t>::const_iterator hash = hashes.begin(); hash != hashes.end(); ++hash) {
+			const size_t bucket = Bucket(*hash);
+			const Entry* first = entries_.data() + buckets_[bucket];
+			const Entry* last = entries_.data() + buckets_[bucket + 1];
+			for (; first != last; ++first)
+				if (first->hash == *hash)
+					candidates.push_back(first->key);
+		}
+
+		std::sort(candidates.begin(), candidates.end());
+		candidates.erase(std::unique(candidates.begin(), candidates.end()), candidates.end());
+
+		/* candidates may be up to twice as far, or just hash collisions */
+		const DistanceMatcher<Char> matcher(string, length);
+		for (std::vector<uint32_t>::const_iterator key = candidates.begin(); key != candidates.end(); ++key) {
+			const Char* keystring = &chars_[offsets_[*key]];
+			const size_t keylength = offsets_[*key + 1] - offsets_[*key];
+
+			if (matcher.Distance(keystring, keylength, distance) <= distance) {
+				if (!appender.Append(keystring, keylength, payloads_[*key]))
+					return;
+			}
+		}
+	}
+};
+
+}
+
+#endif
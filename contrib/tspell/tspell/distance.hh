@@ -0,0 +1,172 @@
+/*
+ * Copyright (C) 2011 Dmitry Marakasov
+ *
+ * This file is part of tspell.
+ *
+ * tspell is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * tspell is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with tspell.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef TSPELL_DISTANCE_HH
+#define TSPELL_DISTANCE_HH
+
+#include <algorithm>
+#include <vector>
+
+#include <stddef.h>
+
+namespace TSpell {
+
+/*
+ * Edit distance between two strings, where edits are insertion,
+ * removal or change of a character and swap of two adjacent
+ * characters (restricted Damerau-Levenshtein distance, same as
+ * used by trie search). Only computed up to given bound; anything
+ * farther is reported as bound + 1.
+ */
+template<class Char>
+int BoundedDistance(const Char* a, size_t alen, const Char* b, size_t blen, int bound) {
+	const int unreachable = bound + 1;
+
+	/* common prefix and suffix don't affect the distance */
+	while (alen > 0 && blen > 0 && *a == *b) {
+		++a; ++b;
+		--alen; --blen;
+	}
+	while (alen > 0 && blen > 0 && a[alen - 1] == b[blen - 1]) {
+		--alen; --blen;
+	}
+
+	if (alen > blen) {
+		std::swap(a, b);
+		std::swap(alen, blen);
+	}
+
+	if (blen - alen > (size_t)bound)
+		return unreachable;
+	if (alen == 0)
+		return (int)blen;
+
+	/* three rows: two previous ones are needed for swaps */
+	const size_t width = blen + 1;
+	std::vector<int> rows(width * 3);
+	int* prevprev = &rows[0];
+	int* prev = &rows[width];
+	int* row = &rows[width * 2];
+
+	for (size_t j = 0; j < width; ++j)
+		prev[j] = std::min((int)j, unreachable);
+
+	for (size_t i = 1; i <= alen; ++i) {
+		int rowmin = row[0] = std::min((int)i, unreachable);
+		for (size_t j = 1; j < width; ++j) {
+			int cell = std::min(prev[j], row[j - 1]) + 1;
+			cell = std::min(cell, prev[j - 1] + (a[i - 1] == b[j - 1] ? 0 : 1));
+			if (i > 1 && j > 1 && a[i - 1] == b[j - 2] && a[i - 2] == b[j - 1])
+				cell = std::min(cell, prevprev[j - 2] + 1);
+			row[j] = cell = std::min(cell, unreachable);
+			rowmin = std::min(rowmin, cell);
+		}
+
+		if (rowmin > bound)
+			return unreachable;
+
+		int* tmp = prevprev;
+		prevprev = prev;
+		prev = row;
+		row = tmp;
+	}
+
+	return prev[blen];
+}
+
+/* buffers for DamerauDistance, which may be reused between calls */
+struct DamerauScratch {
+	std::vector<size_t> lastrow;
+	std::vector<int> matrix;
+};
+
+/*
+ * Unrestricted Damerau-Levenshtein distance, which, unlike the
+ * restricted one, allows edits between swapped characters and thus
+ * is a metric (satisfies triangle inequality). Never larger than
+ * restricted distance.
+ *
+ * Only computed up to given bound; anything farther is reported as
+ * bound + 1. Minimum of a matrix row never decreases from row to row
+ * (a transposition costs at least as many edits as rows it skips), so
+ * computation stops at the first row entirely beyond the bound.
+ */
+template<class Char>
+int DamerauDistance(const Char* a, size_t alen, const Char* b, size_t blen, int bound, DamerauScratch& scratch) {
+	const int unreachable = bound + 1;
+
+	if ((alen > blen ? alen - blen : blen - alen) > (size_t)bound)
+		return unreachable;
+	if (alen == 0 || blen == 0)
+		return (int)(alen + blen);
+
+	/* last row in which character of each column was seen in a; the
+	 * column only reads and updates its own entry, so rows may be
+	 * computed in place */
+	std::vector<size_t>& lastrow = scratch.lastrow;
+	lastrow.assign(blen, 0);
+
+	/* matrix with extra border row and column */
+	const size_t width = blen + 2;
+	const int infinity = (int)(alen + blen);
+	std::vector<int>& matrix = scratch.matrix;
+	matrix.resize(width * (alen + 2));
+
+	matrix[0] = infinity;
+	for (size_t i = 0; i <= alen; ++i) {
+		matrix[(i + 1) * width] = infinity;
+		matrix[(i + 1) * width + 1] = (int)i;
+	}
+	for (size_t j = 0; j <= blen; ++j) {
+		matrix[j + 1] = infinity;
+		matrix[width + j + 1] = (int)j;
+	}
+
+	for (size_t i = 1; i <= alen; ++i) {
+		size_t lastcol = 0;
+		int rowmin = matrix[(i + 1) * width + 1];
+		for (size_t j = 1; j <= blen; ++j) {
+			const size_t i1 = lastrow[j - 1];
+			const size_t j1 = lastcol;
+
+			int cost = 1;
+			if (a[i - 1] == b[j - 1]) {
+				cost = 0;
+				lastcol = j;
+				lastrow[j - 1] = i;
+			}
+
+			int cell = matrix[i * width + j] + cost;
+			cell = std::min(cell, matrix[(i + 1) * width + j] + 1);
+			cell = std::min(cell, matrix[i * width + j + 1] + 1);
+			cell = std::min(cell, matrix[i1 * width + j1] + (int)(i - i1 - 1) + 1 + (int)(j - j1 - 1));
+			matrix[(i + 1) * width + j + 1] = cell;
+			rowmin = std::min(rowmin, cell);
+		}
+
+		if (rowmin > bound)
+			return unreachable;
+	}
+
+	return std::min(matrix[(alen + 1) * width + blen + 1], unreachable);
+}
+
+}
+
+#endif
@@ -0,0 +1,238 @@
+/*
+ * Copyright (C) 2011 Dmitry Marakasov
+ *
+ * This file is part of tspell.
+ *
+ * tspell is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * tspell is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with tspell.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef TSPELL_FLATMULTIMAP_HH
+#define TSPELL_FLATMULTIMAP_HH
+
+#include <vector>
+
+#include <stdint.h>
+
+#include <tspell/image.hh>
+#include <tspell/stringpool.hh>
+
+namespace TSpell {
+
+/*
+ * Hash multimap from strings to plain values. Keys are kept in a
+ * string pool, so each key has an id; values of each key are kept
+ * together in insertion order, so lookup is a single probe
+ * sequence followed by a walk over contiguous array. Once filled,
+ * the map may be frozen, which packs all values into a single
+ * array, the same layout as used by images
+ */
+template<class Char, class Value>
+class FlatMultiMap {
+public:
+	static const uint32_t NOT_FOUND = BasicStringPool<Char>::NOT_FOUND;
+
+	/* values of a single key */
+	class Range {
+	private:
+		const Value* first_;
+		const Value* last_;
+
+	public:
+		Range(const Value* first = NULL, const Value* last = NULL) : first_(first), last_(last) {
+		}
+
+		const Value* begin() const {
+			return first_;
+		}
+
+		const Value* end() const {
+			return last_;
+		}
+
+		size_t size() const {
+			return last_ - first_;
+		}
+
+		bool empty() const {
+			return first_ == last_;
+		}
+	};
+
+private:
+	BasicStringPool<Char> keys_;
+
+	/* values of each key while the map is mutable */
+	std::vector<std::vector<Value> > values_;
+
+	/* values of key i are [offsets_[i], offsets_[i + 1]) of values
+	 * array when the map is frozen; arrays are either own or point
+	 * to an image */
+	ImageArray<uint32_t> packed_offsets_;
+	ImageArray<Value> packed_values_;
+	bool packed_;
+
+private:
+	/* converts packed values back to mutable form */
+	void Unpack() {
+		values_.resize(keys_.GetSize());
+		for (uint32_t id = 0; id < keys_.GetSize(); ++id)
+			values_[id].assign(packed_values_.GetData() + packed_offsets_[id], packed_values_.GetData() + packed_offsets_[id + 1]);
+
+		packed_offsets_ = ImageArray<uint32_t>();
+		packed_values_ = ImageArray<Value>();
+		packed_ = false;
+	}
+
+public:
+	FlatMultiMap() : packed_(false) {
+	}
+
+	/* packs values into flat arrays; map is unpacked back on next Insert */
+	void Freeze() {
+		if (packed_)
+			return;
+
+		std::vector<uint32_t> offsets;
+		std::vector<Value> values;
+		offsets.reserve(values_.size() + 1);
+		values.reserve(GetValueCount());
+
+		offsets.push_back(0);
+		for (typename std::vector<std::vector<Value> >::const_iterator i = values_.begin(); i != values_.end(); ++i) {
+			values.insert(values.end(), i->begin(), i->end());
+			offsets.push_back(values.size());
+		}
+
+		packed_offsets_.Assign(offsets);
+		packed_values_.Assign(values);
+		std::vector<std::vector<Value> >().swap(values_);
+		packed_ = true;
+	}
+
+	/* adds value to the key; returns id of the key */
+	uint32_t Insert(const Char* key, size_t length, const Value& value) {
+		if (packed_)
+			Unpack();
+
+		const uint32_t id = keys_.Intern(key, length);
+		if (id == values_.size())
+			values_.push_back(std::vector<Value>());
+
+		values_[id].push_back(value);
+
+		return id;
+	}
+
+	/* returns id of the key, or NOT_FOUND */
+	uint32_t Find(const Char* key, size_t length) const {
+		return keys_.Find(key, length);
+	}
+
+	/* values of the key with given id; empty for NOT_FOUND */
+	Range GetValues(uint32_t id) const {
+		if (id == NOT_FOUND)
+			return Range();
+		if (packed_)
+			return Range(packed_values_.GetData() + packed_offsets_[id], packed_values_.GetData() + packed_offsets_[id + 1]);
+		return Range(values_[id].data(), values_[id].data() + values_[id].size());
+	}
+
+	Range GetValues(const Char* key, size_t length) const {
+		return GetValues(Find(key, length));
+	}
+
+	const Char* GetKeyData(uint32_t id) const {
+		return keys_.GetData(id);
+	}
+
+	size_t GetKeyLength(uint32_t id) const {
+		return keys_.GetLength(id);
+	}
+
+	/* number of distinct keys */
+	size_t GetSize() const {
+		return keys_.GetSize();
+	}
+
+	/* number of values of all keys */
+	size_t GetValueCount() const {
+		if (packed_)
+			return packed_values_.GetSize();
+
+		size_t count = 0;
+		for (typename std::vector<std::vector<Value> >::const_iterator i = values_.begin(); i != values_.end(); ++i)
+			count += i->size();
+		return count;
+	}
+
+	/* bytes of owned storage; mapped image is not counted */
+	size_t GetMemoryUsage() const {
+		size_t usage = keys_.GetMemoryUsage() + packed_offsets_.GetMemoryUsage() + packed_values_.GetMemoryUsage();
+		usage += values_.capacity() * sizeof(std::vector<Value>);
+		for (typename std::vector<std::vector<Value> >::const_iterator i = values_.begin(); i != values_.end(); ++i)
+			usage += i->capacity() * sizeof(Value);
+		return usage;
+	}
+
+	void WriteImage(ImageWriter& writer) const {
+		keys_.WriteImage(writer);
+
+		if (packed_) {
+			writer.Write(packed_offsets_);
+			writer.Write(packed_values_);
+			return;
+		}
+
+		std::vector<uint32_t> offsets(1, 0);
+		std::vector<Value> values;
+		for (typename std::vector<std::vector<Value> >::const_iterator i = values_.begin(); i != values_.end(); ++i) {
+			values.insert(values.end(), i->begin(), i->end());
+			offsets.push_back(values.size());
+		}
+
+		writer.Write(offsets);
+		writer.Write(values);
+	}
+
+	/*
+	 * Replaces map contents with arrays written by WriteImage, which
+	 * are used in place; returns false if they are malformed
+	 */
+	bool MapImage(ImageReader& reader) {
+		BasicStringPool<Char> keys;
+		ImageArray<uint32_t> offsets;
+		ImageArray<Value> values;
+
+		if (!keys.MapImage(reader) || !reader.Read(offsets) || !reader.Read(values))
+			return false;
+
+		if (offsets.GetSize() != keys.GetSize() + 1 || offsets[0] != 0 || offsets[keys.GetSize()] != values.GetSize())
+			return false;
+		for (size_t i = 0; i < keys.GetSize(); ++i)
+			if (offsets[i] > offsets[i + 1])
+				return false;
+
+		keys_ = keys;
+		std::vector<std::vector<Value> >().swap(values_);
+		packed_offsets_.Map(offsets.GetData(), offsets.GetSize());
+		packed_values_.Map(values.GetData(), values.GetSize());
+		packed_ = true;
+
+		return true;
+	}
+};
+
+}
+
+#endif
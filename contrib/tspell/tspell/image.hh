@@ -0,0 +1,241 @@
+/*
+ * Copyright (C) 2011 Dmitry Marakasov
+ *
+ * This file is part of tspell.
+ *
+ * tspell is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * tspell is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with tspell.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef TSPELL_IMAGE_HH
+#define TSPELL_IMAGE_HH
+
+#include <vector>
+#include <string>
+
+#include <stdint.h>
+#include <string.h>
+
+namespace TSpell {
+
+/*
+ * Array which either owns its elements or refers to ones in a
+ * mapped image; modifying a mapped array copies it first
+ */
+template<class T>
+class ImageArray {
+private:
+	std::vector<T> storage_;
+	const T* data_;
+	size_t size_;
+	bool mapped_;
+
+private:
+	void Sync() {
+		data_ = storage_.data();
+		size_ = storage_.size();
+	}
+
+	void Own() {
+		if (mapped_) {
+			storage_.assign(data_, data_ + size_);
+			mapped_ = false;
+			Sync();
+		}
+	}
+
+public:
+	ImageArray() : data_(NULL), size_(0), mapped_(false) {
+	}
+
+	ImageArray(size_t size, const T& value) : storage_(size, value), mapped_(false) {
+		Sync();
+	}
+
+	/* copy of a mapped array refers to the same image */
+	ImageArray(const ImageArray& other) : data_(NULL), size_(0), mapped_(false) {
+		*this = other;
+	}
+
+	ImageArray& operator=(const ImageArray& other) {
+		if (this == &other)
+			return *this;
+
+		if (other.mapped_) {
+			Map(other.data_, other.size_);
+		} else {
+			storage_ = other.storage_;
+			mapped_ = false;
+			Sync();
+		}
+		return *this;
+	}
+
+	const T& operator[](size_t i) const {
+		return data_[i];
+	}
+
+	const T* GetData() const {
+		return data_;
+	}
+
+	size_t GetSize() const {
+		return size_;
+	}
+
+	bool IsMapped() const {
+		return mapped_;
+	}
+
+	/* bytes of owned storage; mapped data is not counted */
+	size_t GetMemoryUsage() const {
+		return storage_.capacity() * sizeof(T);
+	}
+
+	void PushBack(const T& value) {
+		Own();
+		storage_.push_back(value);
+		Sync();
+	}
+
+	void Append(const T* first, const T* last) {
+		Own();
+		storage_.insert(storage_.end(), first, last);
+		Sync();
+	}
+
+	void Set(size_t i, const T& value) {
+		Own();
+		storage_[i] = value;
+	}
+
+	/* takes contents of the vector, leaving it empty */
+	void Assign(std::vector<T>& storage) {
+		storage_.swap(storage);
+		std::vector<T>().swap(storage);
+		mapped_ = false;
+		Sync();
+	}
+
+	/* refers to elements which must outlive the array or its next modification */
+	void Map(const T* data, size_t size) {
+		std::vector<T>().swap(storage_);
+		data_ = data;
+		size_ = size;
+		mapped_ = true;
+	}
+};
+
+/*
+ * Image is a sequence of arrays, each prefixed with its element
+ * count and element size and padded to 8 bytes, so elements of
+ * every array are aligned as long as the image itself is
+ */
+class ImageWriter {
+private:
+	std::string data_;
+
+public:
+	template<class T>
+	void Write(const T* data, size_t count) {
+		const uint64_t header[2] = { count, sizeof(T) };
+		data_.append(reinterpret_cast<const char*>(header), sizeof(header));
+		data_.append(reinterpret_cast<const char*>(data), sizeof(T) * count);
+		data_.append((8 - data_.length() % 8) % 8, '\0');
+	}
+
+	template<class T>
+	void Write(const ImageArray<T>& array) {
+		Write(array.GetData(), array.GetSize());
+	}
+
+	template<class T>
+	void Write(const std::vector<T>& array) {
+		Write(array.data(), array.size());
+	}
+
+	const std::string& GetData() const {
+		return data_;
+	}
+};
+
+/* reads arrays written by ImageWriter in place */
+class ImageReader {
+private:
+	const char* data_;
+	size_t size_;
+	size_t position_;
+
+public:
+	ImageReader(const void* data, size_t size) : data_(static_cast<const char*>(data)), size_(size), position_(0) {
+	}
+
+	/* returns false if the image is truncated or element size mismatches */
+	template<class T>
+	bool Read(const T*& data, size_t& count) {
+		uint64_t header[2];
+		if (size_ - position_ < sizeof(header) || reinterpret_cast<uintptr_t>(data_ + position_) % 8 != 0)
+			return false;
+
+		memcpy(header, data_ + position_, sizeof(header));
+		if (header[1] != sizeof(T) || header[0] > (size_ - position_ - sizeof(header)) / sizeof(T))
+			return false;
+
+		const size_t length = sizeof(T) * header[0];
+		const size_t padded = length + (8 - length % 8) % 8;
+		if (padded > size_ - position_ - sizeof(header))
+			return false;
+
+		data = reinterpret_cast<const T*>(data_ + position_ + sizeof(header));
+		count = header[0];
+		position_ += sizeof(header) + padded;
+
+		return true;
+	}
+
+	template<class T>
+	bool Read(ImageArray<T>& array) {
+		const T* data;
+		size_t count;
+		if (!Read(data, count))
+			return false;
+		array.Map(data, count);
+		return true;
+	}
+
+	bool IsAtEnd() const {
+		return position_ == size_;
+	}
+};
+
+/* fast 64 bit checksum for detecting damaged images */
+inline uint64_t ImageChecksum(const void* data, size_t size) {
+	const unsigned char* bytes = static_cast<const unsigned char*>(data);
+	uint64_t hash = 0xcbf29ce484222325ULL ^ size;
+
+	size_t i = 0;
+	for (; i + 8 <= size; i += 8) {
+		uint64_t word;
+		memcpy(&word, bytes + i, sizeof(word));
+		hash = (hash ^ word) * 0x100000001b3ULL;
+		hash ^= hash >> 29;
+	}
+	for (; i < size; ++i)
+		hash = (hash ^ bytes[i]) * 0x100000001b3ULL;
+
+	return hash;
+}
+
+}
+
+#endif
@@ -0,0 +1,91 @@
+/*
+ * Copyright (C) 2011 Dmitry Marakasov
+ *
+ * This file is part of tspell.
+ *
+ * tspell is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * tspell is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with tspell.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef TSPELL_MAPPEDFILE_HH
+#define TSPELL_MAPPEDFILE_HH
+
+#include <stdexcept>
+#include <string>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+namespace TSpell {
+
+/*
+ * Read only shared memory mapping of a whole file, suitable for
+ * trie images (see TrieBase::MapImage); processes mapping the same
+ * file share its physical pages
+ */
+class MappedFile {
+private:
+	void* data_;
+	size_t size_;
+
+private:
+	MappedFile(const MappedFile&);
+	MappedFile& operator=(const MappedFile&);
+
+public:
+	MappedFile(const std::string& filename) : data_(NULL), size_(0) {
+		int f;
+		if ((f = open(filename.c_str(), O_RDONLY)) == -1)
+			throw std::runtime_error(std::string("Cannot open: ") + strerror(errno));
+
+		struct stat st;
+		if (fstat(f, &st) == -1) {
+			int error = errno;
+			close(f);
+			throw std::runtime_error(std::string("Cannot stat: ") + strerror(error));
+		}
+
+		size_ = st.st_size;
+
+		/* zero length mappings are not allowed */
+		if (size_ > 0 && (data_ = mmap(NULL, size_, PROT_READ, MAP_SHARED, f, 0)) == MAP_FAILED) {
+			int error = errno;
+			close(f);
+			throw std::runtime_error(std::string("Cannot map: ") + strerror(error));
+		}
+
+		/* mapping stays valid after the descriptor is closed */
+		close(f);
+	}
+
+	~MappedFile() {
+		if (size_ > 0)
+			munmap(data_, size_);
+	}
+
+	const void* GetData() const {
+		return data_;
+	}
+
+	size_t GetSize() const {
+		return size_;
+	}
+};
+
+}
+
+#endif
@@ -0,0 +1,144 @@
+/*
+ * Copyright (C) 2011 Dmitry Marakasov
+ *
+ * This file is part of tspell.
+ *
+ * tspell is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * tspell is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with tspell.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef TSPELL_MATCHER_HH
+#define TSPELL_MATCHER_HH
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include <tspell/distance.hh>
+
+namespace TSpell {
+
+/*
+ * Query prepared for checking BoundedDistance against many strings
+ *
+ * Uses bit-parallel algorithm by Myers with Hyyro's extension for
+ * swaps: a whole DP column is kept as bit vectors of vertical deltas,
+ * so every character of a checked string is processed by a handful of
+ * word operations. Queries longer than a machine word fall back to
+ * BoundedDistance.
+ */
+template<class Char>
+class DistanceMatcher {
+private:
+	typedef uint64_t Word;
+
+	static const size_t MAX_LENGTH = 64;
+	static const size_t TABLE_SIZE = 128; /* at least twice MAX_LENGTH */
+
+	struct Slot {
+		Char ch;
+		Word mask; /* positions of ch in the query; 0 for empty slot */
+	};
+
+private:
+	const Char* query_;
+	size_t length_;
+
+	/* open addressing table of query characters */
+	Slot table_[TABLE_SIZE];
+
+private:
+	static size_t Hash(Char ch) {
+		return ((uint32_t)ch * 2654435761U) >> 25;
+	}
+
+	Word GetMask(Char ch) const {
+		for (size_t slot = Hash(ch); table_[slot].mask != 0; slot = (slot + 1) % TABLE_SIZE)
+			if (table_[slot].ch == ch)
+				return table_[slot].mask;
+		return 0;
+	}
+
+public:
+	/* query is not copied and must outlive the matcher */
+	DistanceMatcher(const Char* query, size_t length) : query_(query), length_(length) {
+		for (size_t slot = 0; slot < TABLE_SIZE; ++slot)
+			table_[slot].mask = 0;
+
+		if (length_ > MAX_LENGTH)
+			return;
+
+		for (size_t i = 0; i < length_; ++i) {
+			size_t slot = Hash(query_[i]);
+			while (table_[slot].mask != 0 && table_[slot].ch != query_[i])
+				slot = (slot + 1) % TABLE_SIZE;
+			table_[slot].ch = query_[i];
+			table_[slot].mask |= (Word)1 << i;
+		}
+	}
+
+	/* same as BoundedDistance(query, string, bound) */
+	int Distance(const Char* string, size_t length, int bound) const {
+		const int unreachable = bound + 1;
+
+		if (length_ > MAX_LENGTH)
+			return BoundedDistance(query_, length_, string, length, bound);
+
+		if ((length > length_ ? length - length_ : length_ - length) > (size_t)bound)
+			return unreachable;
+		if (length_ == 0)
+			return (int)length;
+
+		const Word last = (Word)1 << (length_ - 1);
+
+		Word vp = ~(Word)0; /* vertical +1 deltas */
+		Word vn = 0;        /* vertical -1 deltas */
+		Word d0 = 0;        /* diagonal zero deltas of previous column */
+		Word prevmask = 0;
+		int score = (int)length_;
+
+		for (size_t j = 0; j < length; ++j) {
+			const Word mask = GetMask(string[j]);
+
+			/* swap of query characters i-1, i with string characters j, j-1 */
+			const Word swapped = (((~d0) & mask) << 1) & prevmask;
+
+			d0 = (((mask & vp) + vp) ^ vp) | mask | vn | swapped;
+
+			Word hp = vn | ~(d0 | vp);
+			Word hn = d0 & vp;
+
+			if (hp & last)
+				++score;
+			else if (hn & last)
+				--score;
+
+			/* score may only decrease by one per remaining character */
+			if (score - (int)(length - j - 1) > bound)
+				return unreachable;
+
+			hp = (hp << 1) | 1;
+			hn <<= 1;
+
+			vp = hn | ~(d0 | hp);
+			vn = hp & d0;
+
+			prevmask = mask;
+		}
+
+		return score > bound ? unreachable : score;
+	}
+};
+
+}
+
+#endif
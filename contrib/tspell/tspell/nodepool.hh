@@ -0,0 +1,82 @@
+/*
+ * Copyright (C) 2011 Dmitry Marakasov
+ *
+ * This file is part of tspell.
+ *
+ * tspell is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * tspell is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with tspell.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef TSPELL_NODEPOOL_HH
+#define TSPELL_NODEPOOL_HH
+
+#include <cstddef>
+#include <new>
+#include <vector>
+
+namespace TSpell {
+
+/*
+ * Chunked arena for trie nodes
+ *
+ * Nodes are carved sequentially from fixed-size chunks and are never
+ * freed individually; the whole pool is released at once on destruction.
+ * Only suitable for trivially destructible types.
+ */
+template<class T, size_t ChunkSize = 4096>
+class NodePool {
+private:
+	std::vector<T*> chunks_;
+	size_t used_;
+
+private:
+	NodePool(const NodePool&);
+	NodePool& operator=(const NodePool&);
+
+public:
+	NodePool() : used_(ChunkSize) {
+	}
+
+	~NodePool() {
+		Clear();
+	}
+
+	T* Allocate() {
+		if (used_ == ChunkSize) {
+			chunks_.push_back(static_cast<T*>(::operator new(sizeof(T) * ChunkSize)));
+			used_ = 0;
+		}
+
+		return chunks_.back() + used_++;
+	}
+
+	void Clear() {
+		for (typename std::vector<T*>::iterator i = chunks_.begin(); i != chunks_.end(); ++i)
+			::operator delete(*i);
+		chunks_.clear();
+		used_ = ChunkSize;
+	}
+
+	size_t GetSize() const {
+		return chunks_.empty() ? 0 : (chunks_.size() - 1) * ChunkSize + used_;
+	}
+
+	/* bytes allocated, including unused part of the last chunk */
+	size_t GetMemoryUsage() const {
+		return chunks_.size() * ChunkSize * sizeof(T);
+	}
+};
+
+}
+
+#endif
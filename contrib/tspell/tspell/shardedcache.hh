@@ -0,0 +1,161 @@
+/*
+ * Copyright (C) 2011 Dmitry Marakasov
+ *
+ * This file is part of tspell.
+ *
+ * tspell is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * tspell is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with tspell.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef TSPELL_SHARDEDCACHE_HH
+#define TSPELL_SHARDEDCACHE_HH
+
+#include <vector>
+#include <algorithm>
+#include <string>
+#include <mutex>
+#include <functional>
+#include <unordered_map>
+
+#include <stdint.h>
+
+namespace TSpell {
+
+/*
+ * Bounded string keyed cache safe for concurrent use. Keys are
+ * spread over independently locked shards; each shard evicts with
+ * CLOCK algorithm, which gives an entry used since the last sweep
+ * another chance
+ */
+template<class Value>
+class ShardedCache {
+public:
+	struct Stats {
+		uint64_t hits;
+		uint64_t misses;
+		size_t size;
+	};
+
+private:
+	static const size_t SHARDS = 16;
+
+	struct Entry {
+		std::string key;
+		Value value;
+		bool referenced;
+	};
+
+	struct Shard {
+		std::mutex mutex;
+		std::unordered_map<std::string, size_t> index;  /* key to position in entries */
+		std::vector<Entry> entries;
+		size_t hand;
+		uint64_t hits;
+		uint64_t misses;
+
+		Shard() : hand(0), hits(0), misses(0) {
+		}
+	};
+
+private:
+	Shard shards_[SHARDS];
+	const size_t shard_capacity_;
+
+private:
+	ShardedCache(const ShardedCache&);
+	ShardedCache& operator=(const ShardedCache&);
+
+	Shard& GetShard(const std::string& key) {
+		return shards_[std::hash<std::string>()(key) % SHARDS];
+	}
+
+public:
+	ShardedCache(size_t capacity) : shard_capacity_(std::max((size_t)1, (capacity + SHARDS - 1) / SHARDS)) {
+	}
+
+	/* copies cached value for the key; returns false on miss */
+	bool Get(const std::string& key, Value& value) {
+		Shard& shard = GetShard(key);
+		std::lock_guard<std::mutex> lock(shard.mutex);
+
+		typename std::unordered_map<std::string, size_t>::const_iterator found = shard.index.find(key);
+		if (found == shard.index.end()) {
+			++shard.misses;
+			return false;
+		}
+
+		Entry& entry = shard.entries[found->second];
+		entry.referenced = true;
+		value = entry.value;
+		++shard.hits;
+
+		return true;
+	}
+
+	void Put(const std::string& key, const Value& value) {
+		Shard& shard = GetShard(key);
+		std::lock_guard<std::mutex> lock(shard.mutex);
+
+		typename std::unordered_map<std::string, size_t>::const_iterator found = shard.index.find(key);
+		if (found != shard.index.end()) {
+			/* concurrent miss has already stored it */
+			shard.entries[found->second].value = value;
+			return;
+		}
+
+		size_t position;
+		if (shard.entries.size() < shard_capacity_) {
+			position = shard.entries.size();
+			shard.entries.push_back(Entry());
+		} else {
+			/* sweep until an entry not used since the last sweep */
+			for (; shard.entries[shard.hand].referenced; shard.hand = (shard.hand + 1) % shard.entries.size())
+				shard.entries[shard.hand].referenced = false;
+
+			position = shard.hand;
+			shard.hand = (shard.hand + 1) % shard.entries.size();
+			shard.index.erase(shard.entries[position].key);
+		}
+
+		Entry& entry = shard.entries[position];
+		entry.key = key;
+		entry.value = value;
+		entry.referenced = false;
+		shard.index[key] = position;
+	}
+
+	/* drops all entries; counters are kept */
+	void Clear() {
+		for (size_t i = 0; i < SHARDS; ++i) {
+			std::lock_guard<std::mutex> lock(shards_[i].mutex);
+			shards_[i].index.clear();
+			shards_[i].entries.clear();
+			shards_[i].hand = 0;
+		}
+	}
+
+	Stats GetStats() {
+		Stats stats = Stats();
+		for (size_t i = 0; i < SHARDS; ++i) {
+			std::lock_guard<std::mutex> lock(shards_[i].mutex);
+			stats.hits += shards_[i].hits;
+			stats.misses += shards_[i].misses;
+			stats.size += shards_[i].entries.size();
+		}
+		return stats;
+	}
+};
+
+}
+
+#endif
@@ -0,0 +1,105 @@
+/*
+ * Copyright (C) 2011 Dmitry Marakasov
+ *
+ * This file is part of tspell.
+ *
+ * tspell is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * tspell is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with tspell.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef TSPELL_STATESET_HH
+#define TSPELL_STATESET_HH
+
+#include <vector>
+
+#include <stdint.h>
+
+namespace TSpell {
+
+/*
+ * Small open addressing map from search state (trie node, query
+ * position) to the largest remaining distance it was visited with
+ */
+class StateSet {
+private:
+	struct Entry {
+		uint64_t key;
+		int value; /* -1 for empty slot */
+
+		Entry() : key(0), value(-1) {
+		}
+	};
+
+private:
+	std::vector<Entry> entries_;
+	size_t count_;
+	int shift_;
+
+private:
+	size_t Slot(uint64_t key) const {
+		return (size_t)((key * 0x9E3779B97F4A7C15ULL) >> shift_);
+	}
+
+	void Grow() {
+		std::vector<Entry> old;
+		old.swap(entries_);
+
+		entries_.resize(old.size() * 2);
+		--shift_;
+
+		for (std::vector<Entry>::const_iterator i = old.begin(); i != old.end(); ++i) {
+			if (i->value < 0)
+				continue;
+
+			size_t slot = Slot(i->key);
+			while (entries_[slot].value >= 0)
+				slot = (slot + 1) & (entries_.size() - 1);
+			entries_[slot] = *i;
+		}
+	}
+
+public:
+	StateSet() : entries_(64), count_(0), shift_(64 - 6) {
+	}
+
+	/*
+	 * Stores value for the state if it's larger than one already
+	 * stored; returns previously stored value or -1 if the state
+	 * wasn't seen before
+	 */
+	int Raise(uint32_t node, uint32_t position, int value) {
+		const uint64_t key = ((uint64_t)node << 32) | position;
+
+		size_t slot = Slot(key);
+		for (; entries_[slot].value >= 0; slot = (slot + 1) & (entries_.size() - 1)) {
+			if (entries_[slot].key == key) {
+				int old = entries_[slot].value;
+				if (value > old)
+					entries_[slot].value = value;
+				return old;
+			}
+		}
+
+		entries_[slot].key = key;
+		entries_[slot].value = value;
+
+		if (++count_ * 2 > entries_.size())
+			Grow();
+
+		return -1;
+	}
+};
+
+}
+
+#endif
@@ -0,0 +1,208 @@
+/*
+ * Copyright (C) 2011 Dmitry Marakasov
+ *
+ * This file is part of tspell.
+ *
+ * tspell is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * tspell is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with tspell.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef TSPELL_STRINGPOOL_HH
+#define TSPELL_STRINGPOOL_HH
+
+#include <vector>
+#include <string>
+#include <algorithm>
+
+#include <stdint.h>
+
+#include <tspell/image.hh>
+
+namespace TSpell {
+
+/*
+ * Pool of unique strings, which are identified by 32 bit ids.
+ * Characters of all strings are stored back to back in a single
+ * buffer, so a string takes its length plus a few bytes of index
+ * instead of a separate heap block
+ */
+template<class Char>
+class BasicStringPool {
+public:
+	static const uint32_t NOT_FOUND = 0xffffffff;
+
+private:
+	struct Slot {
+		uint32_t hash;
+		uint32_t id; /* NOT_FOUND for empty slot */
+
+		Slot() : hash(0), id(NOT_FOUND) {
+		}
+	};
+
+private:
+	ImageArray<Char> data_;
+	ImageArray<uint32_t> offsets_; /* string i is [offsets_[i], offsets_[i + 1]) */
+	ImageArray<Slot> slots_;
+
+private:
+	/* FNV-1a */
+	static uint32_t HashOf(const Char* string, size_t length) {
+		uint32_t hash = 2166136261U;
+		for (size_t i = 0; i < length; ++i)
+			hash = (hash ^ (uint32_t)string[i]) * 16777619U;
+		return hash;
+	}
+
+	static size_t Start(uint32_t hash, size_t slots) {
+		return (size_t)(((uint64_t)hash * 0x9E3779B97F4A7C15ULL) >> 32) & (slots - 1);
+	}
+
+	bool Equals(uint32_t id, const Char* string, size_t length) const {
+		return GetLength(id) == length && std::equal(string, string + length, GetData(id));
+	}
+
+	size_t Lookup(const Char* string, size_t length, uint32_t hash) const {
+		size_t slot = Start(hash, slots_.GetSize());
+		for (; slots_[slot].id != NOT_FOUND; slot = (slot + 1) & (slots_.GetSize() - 1))
+			if (slots_[slot].hash == hash && Equals(slots_[slot].id, string, length))
+				break;
+		return slot;
+	}
+
+	void Grow() {
+		std::vector<Slot> slots(slots_.GetSize() * 2);
+
+		for (size_t i = 0; i < slots_.GetSize(); ++i) {
+			if (slots_[i].id == NOT_FOUND)
+				continue;
+
+			size_t slot = Start(slots_[i].hash, slots.size());
+			while (slots[slot].id != NOT_FOUND)
+				slot = (slot + 1) & (slots.size() - 1);
+			slots[slot] = slots_[i];
+		}
+
+		slots_.Assign(slots);
+	}
+
+public:
+	BasicStringPool() : offsets_(1, 0), slots_(16, Slot()) {
+	}
+
+	/* returns id of the string, adding it to the pool if needed */
+	uint32_t Intern(const Char* string, size_t length) {
+		const uint32_t hash = HashOf(string, length);
+		const size_t slot = Lookup(string, length, hash);
+
+		if (slots_[slot].id != NOT_FOUND)
+			return slots_[slot].id;
+
+		const uint32_t id = GetSize();
+
+		data_.Append(string, string + length);
+		offsets_.PushBack(data_.GetSize());
+
+		Slot added;
+		added.hash = hash;
+		added.id = id;
+		slots_.Set(slot, added);
+
+		if (offsets_.GetSize() * 2 > slots_.GetSize())
+			Grow();
+
+		return id;
+	}
+
+	uint32_t Intern(const std::basic_string<Char>& string) {
+		return Intern(string.data(), string.length());
+	}
+
+	/* returns id of the string, or NOT_FOUND if it's not in the pool */
+	uint32_t Find(const Char* string, size_t length) const {
+		return slots_[Lookup(string, length, HashOf(string, length))].id;
+	}
+
+	uint32_t Find(const std::basic_string<Char>& string) const {
+		return Find(string.data(), string.length());
+	}
+
+	const Char* GetData(uint32_t id) const {
+		return data_.GetData() + offsets_[id];
+	}
+
+	size_t GetLength(uint32_t id) const {
+		return offsets_[id + 1] - offsets_[id];
+	}
+
+	std::basic_string<Char> Get(uint32_t id) const {
+		return std::basic_string<Char>(GetData(id), GetLength(id));
+	}
+
+	/* number of strings in the pool */
+	size_t GetSize() const {
+		return offsets_.GetSize() - 1;
+	}
+
+	/* bytes of owned storage; mapped image is not counted */
+	size_t GetMemoryUsage() const {
+		return data_.GetMemoryUsage() + offsets_.GetMemoryUsage() + slots_.GetMemoryUsage();
+	}
+
+	void WriteImage(ImageWriter& writer) const {
+		writer.Write(data_);
+		writer.Write(offsets_);
+		writer.Write(slots_);
+	}
+
+	/*
+	 * Replaces pool contents with arrays written by WriteImage, which
+	 * are used in place; returns false if they are malformed
+	 */
+	bool MapImage(ImageReader& reader) {
+		ImageArray<Char> data;
+		ImageArray<uint32_t> offsets;
+		ImageArray<Slot> slots;
+
+		if (!reader.Read(data) || !reader.Read(offsets) || !reader.Read(slots))
+			return false;
+
+		if (offsets.GetSize() == 0)
+			return false;
+
+		const size_t size = offsets.GetSize() - 1;
+		if (offsets[0] != 0 || offsets[size] != data.GetSize())
+			return false;
+		if (slots.GetSize() < 2 || (slots.GetSize() & (slots.GetSize() - 1)) != 0 || size * 2 >= slots.GetSize())
+			return false;
+
+		for (size_t i = 0; i < size; ++i)
+			if (offsets[i] > offsets[i + 1])
+				return false;
+		for (size_t i = 0; i < slots.GetSize(); ++i)
+			if (slots[i].id != NOT_FOUND && slots[i].id >= size)
+				return false;
+
+		data_.Map(data.GetData(), data.GetSize());
+		offsets_.Map(offsets.GetData(), offsets.GetSize());
+		slots_.Map(slots.GetData(), slots.GetSize());
+
+		return true;
+	}
+};
+
+typedef BasicStringPool<char> StringPool;
+
+}
+
+#endif
@@ -20,7 +20,6 @@
 #ifndef TSPELL_STRINGTRIE_HH
 #define TSPELL_STRINGTRIE_HH
 
-#include <algorithm>
 #include <string>
 #include <set>
 
@@ -31,8 +30,6 @@ namespace TSpell {
 template<typename Char>
 class StringSetAppender {
 public:
-	typedef Node<Char> node_type;
-
 	typedef std::basic_string<Char> string_type;
 	typedef std::set<string_type> set_type;
 
@@ -43,23 +40,19 @@ public:
 	StringSetAppender(set_type& set) : set_(set) {
 	}
 
-	void Append(const node_type* node) {
-		string_type str;
-		for (const node_type* cur = node; cur; cur = cur->parent)
-			str += cur->ch;
-		std::reverse(str.begin(), str.end());
-
-		set_.insert(str);
+	bool Append(const Char* string, size_t length, uint32_t) {
+		set_.insert(string_type(string, length));
+		return true;
 	}
 };
 
-class StringTrie : public TrieBase<char, StringSetAppender<char> > {
+class StringTrie : public TrieBase<char> {
 private:
-	typedef TrieBase<char, StringSetAppender<char> > base_type;
+	typedef TrieBase<char> base_type;
 
 public:
 	void Insert(const std::string& string) {
-		base_type::Insert(string.c_str(), string.length());
+		base_type::Insert(string.c_str(), string.length(), 0);
 	}
 
 	bool FindExact(const std::string& string) const {
@@ -70,15 +63,20 @@ public:
 		StringSetAppender<char> a(out);
 		base_type::FindApprox(string.c_str(), string.length(), distance, a);
 	}
+
+	void FindApproxAutomaton(const std::string& string, int distance, std::set<std::string>& out) const {
+		StringSetAppender<char> a(out);
+		base_type::FindApproxAutomaton(string.c_str(), string.length(), distance, a);
+	}
 };
 
-class WStringTrie : public TrieBase<wchar_t, StringSetAppender<wchar_t> > {
+class WStringTrie : public TrieBase<wchar_t> {
 private:
-	typedef TrieBase<wchar_t, StringSetAppender<wchar_t> > base_type;
+	typedef TrieBase<wchar_t> base_type;
 
 public:
 	void Insert(const std::wstring& string) {
-		base_type::Insert(string.c_str(), string.length());
+		base_type::Insert(string.c_str(), string.length(), 0);
 	}
 
 	bool FindExact(const std::wstring& string) const {
@@ -89,6 +87,11 @@ public:
 		StringSetAppender<wchar_t> a(out);
 		base_type::FindApprox(string.c_str(), string.length(), distance, a);
 	}
+
+	void FindApproxAutomaton(const std::wstring& string, int distance, std::set<std::wstring>& out) const {
+		StringSetAppender<wchar_t> a(out);
+		base_type::FindApproxAutomaton(string.c_str(), string.length(), distance, a);
+	}
 };
 
 }
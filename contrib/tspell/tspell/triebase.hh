@@ -20,127 +20,913 @@
 #ifndef TSPELL_TRIEBASE_HH
 #define TSPELL_TRIEBASE_HH
 
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <ostream>
+#include <utility>
+#include <vector>
+
+#include <stdint.h>
+
+#include <tspell/nodepool.hh>
+#include <tspell/stateset.hh>
+
 namespace TSpell {
 
+/* payload of nodes which don't terminate any key */
+const uint32_t NO_PAYLOAD = 0xffffffff;
+
+/* mutable node, used while the trie is being filled */
 template<class Char>
 struct Node {
-	Node<Char>* parent;
 	Node<Char>* next;
 	Node<Char>* child;
 	Char ch;
-	bool data;
+	uint32_t payload;
+
+	Node(Char c) : next(NULL), child(NULL), ch(c), payload(NO_PAYLOAD) {
+	}
+};
+
+/*
+ * immutable node of a frozen trie
+ *
+ * Frozen nodes are stored in level order, so children of any node
+ * occupy a contiguous range [children, next node's children) of
+ * the node array. Node 0 is the root; the array is terminated by a
+ * sentinel node which only holds the end of the last children range
+ * and label array.
+ *
+ * Chains of nodes with single child and no key ending at them are
+ * collapsed into a single node, labeled with the whole run of
+ * characters. Labels are stored back to back in node order, so the
+ * label of a node is [label, next node's label) of the label array;
+ * the root has an empty one. First character of the label is also
+ * kept in the node for child lookups.
+ *
+ * Each node also knows the range of lengths of key remainders in its
+ * subtree (after its label), so searches may skip subtrees where no
+ * key has suitable length. Lengths are saturated at MAX_REST, which
+ * for the maximum means "unknown".
+ *
+ * Payloads are only needed on hits, so they are kept in a separate
+ * array to keep nodes compact. For the same reason the flag of a key
+ * ending at the node shares a word with the label offset, so a node
+ * of 16 bit characters takes 12 bytes.
+ */
+template<class Char>
+struct FrozenNode {
+	static const uint8_t MAX_REST = 0xff;
+
+	uint32_t children;
+	uint32_t label : 31;
+	uint32_t data : 1;
+	Char ch;
+	uint8_t minrest;
+	uint8_t maxrest;
 
-	Node(Node<Char>* p, Char c) : parent(p), next(NULL), child(NULL), ch(c), data(false) {
+	FrozenNode(uint32_t ch_idx, uint32_t l, Char c, bool d) : children(ch_idx), label(l), data(d), ch(c), minrest(0), maxrest(0) {
 	}
 };
 
-template<class Char, class Appender>
+/*
+ * Appender which collects payloads of found keys
+ *
+ * Search methods pass every found key to appender's Append and stop
+ * as soon as it returns false.
+ */
+class PayloadAppender {
+private:
+	std::vector<uint32_t>& payloads_;
+
+public:
+	PayloadAppender(std::vector<uint32_t>& payloads) : payloads_(payloads) {
+	}
+
+	template<class Char>
+	bool Append(const Char*, size_t, uint32_t payload) {
+		payloads_.push_back(payload);
+		return true;
+	}
+};
+
+template<class Char>
 class TrieBase {
 protected:
 	typedef Node<Char> node_type;
+	typedef FrozenNode<Char> frozen_node_type;
 
 protected:
 	node_type* root_;
+	NodePool<node_type> pool_;
+
+	/* frozen arrays; point either to own storage or to a mapped image */
+	const frozen_node_type* frozen_nodes_;
+	const uint32_t* frozen_payloads_;
+	const Char* frozen_labels_;
+	uint32_t frozen_size_; /* including sentinel */
+
+	std::vector<frozen_node_type> nodes_storage_;
+	std::vector<uint32_t> payloads_storage_;
+	std::vector<Char> labels_storage_;
+
+	std::atomic<bool> frozen_;
+	std::mutex freeze_mutex_;
+
+private:
+	TrieBase(const TrieBase&);
+	TrieBase& operator=(const TrieBase&);
 
 private:
-	void Insert(node_type* parent, node_type** start, const Char* string, size_t length) {
-		node_type** current = start;
+	/* header of serialized image, followed by nodes, payloads and labels */
+	struct ImageHeader {
+		char magic[8];
+		uint32_t byteorder;  /* IMAGE_BYTEORDER in native order of writer */
+		uint16_t charsize;
+		uint16_t nodesize;
+		uint32_t nodes;      /* including sentinel */
+		uint32_t labels;     /* total length of labels */
+	};
 
-		for (; *current != NULL && (*current)->ch != *string; current = &((*current)->next)) {
-			/* empty */
+	static const char* ImageMagic() {
+		return "TSPTRIE4";
+	}
+
+	static const uint32_t IMAGE_BYTEORDER = 0x01020304;
+
+	/* number of queries walked together by FindApproxBatch */
+	static const size_t BATCH_CHUNK = 256;
+
+	/* pending state of approximate search */
+	struct SearchState {
+		uint32_t node;     /* trie node whose children are to be tried */
+		uint32_t offset;   /* number of node label characters passed */
+		uint32_t position; /* number of consumed query characters */
+		uint32_t depth;    /* number of consumed trie characters */
+		int distance;      /* remaining edit distance */
+		bool transposed;   /* node was reached by swapping two characters */
+
+		SearchState(uint32_t n, uint32_t o, uint32_t p, uint32_t d, int dist, bool t = false) : node(n), offset(o), position(p), depth(d), distance(dist), transposed(t) {
 		}
+	};
 
-		if (*current == NULL)
-			*current = new node_type(parent, *string);
+private:
+	static bool CharLess(const frozen_node_type& node, Char ch) {
+		return node.ch < ch;
+	}
+
+	bool FindChild(uint32_t node, Char ch, uint32_t& found) const {
+		const frozen_node_type* first = &frozen_nodes_[frozen_nodes_[node].children];
+		const frozen_node_type* last = &frozen_nodes_[frozen_nodes_[node + 1].children];
 
-		if (length == 1) {
-			(*current)->data = true;
+		/* children are sorted by character; short ranges are faster to scan */
+		if (last - first > 8) {
+			first = std::lower_bound(first, last, ch, CharLess);
 		} else {
-			Insert(*current, &((*current)->child), string + 1, length - 1);
+			for (; first != last && first->ch < ch; ++first) {
+				/* empty */
+			}
 		}
+
+		if (first == last || first->ch != ch)
+			return false;
+
+		found = first - frozen_nodes_;
+		return true;
 	}
 
-	/* XXX: const */
-	bool FindExact(node_type* start, const Char* string, size_t length) const {
-		node_type* current = start;
+	/* converts mutable tree into level-ordered array and drops the tree;
+	 * as siblings are sorted, so are children ranges in the array */
+	void DoFreeze() {
+		/* last mutable node of each frozen node's chain */
+		std::vector<const node_type*> queue;
+
+		nodes_storage_.clear();
+		payloads_storage_.clear();
+		labels_storage_.clear();
+		nodes_storage_.push_back(frozen_node_type(0, 0, Char(), false));
+		payloads_storage_.push_back(NO_PAYLOAD);
+		queue.push_back(NULL);
 
-		for (; current != NULL && current->ch != *string; current = current->next) {
-			/* empty */
+		for (size_t i = 0; i < queue.size(); ++i) {
+			nodes_storage_[i].children = nodes_storage_.size();
+			for (const node_type* child = (i == 0) ? root_ : queue[i]->child; child != NULL; child = child->next) {
+				const node_type* last = child;
+				nodes_storage_.push_back(frozen_node_type(0, labels_storage_.size(), child->ch, false));
+				labels_storage_.push_back(last->ch);
+				for (; last->payload == NO_PAYLOAD && last->child != NULL && last->child->next == NULL; last = last->child)
+					labels_storage_.push_back(last->child->ch);
+
+				nodes_storage_.back().data = last->payload != NO_PAYLOAD;
+				payloads_storage_.push_back(last->payload);
+				queue.push_back(last);
+			}
 		}
 
-		if (current == NULL)
-			return false;
+		/* sentinel */
+		nodes_storage_.push_back(frozen_node_type(nodes_storage_.size(), labels_storage_.size(), Char(), false));
+		payloads_storage_.push_back(NO_PAYLOAD);
 
-		if (length == 1) {
-			return current->data;
-		} else {
-			return FindExact(current->child, string + 1, length - 1);
+		/* children always follow their parent, so bounds may be collected backwards */
+		for (size_t i = nodes_storage_.size() - 1; i-- > 0; ) {
+			frozen_node_type& node = nodes_storage_[i];
+			unsigned int minrest = node.data ? 0 : frozen_node_type::MAX_REST;
+			unsigned int maxrest = 0;
+			for (uint32_t child = node.children; child != nodes_storage_[i + 1].children; ++child) {
+				const unsigned int labellength = nodes_storage_[child + 1].label - nodes_storage_[child].label;
+				minrest = std::min(minrest, labellength + nodes_storage_[child].minrest);
+				maxrest = std::max(maxrest, labellength + nodes_storage_[child].maxrest);
+			}
+			node.minrest = std::min(minrest, (unsigned int)frozen_node_type::MAX_REST);
+			node.maxrest = std::min(maxrest, (unsigned int)frozen_node_type::MAX_REST);
 		}
-	}
 
-	void FindApprox(node_type* last, node_type* current, const Char* string, size_t length, int distance, Appender& appender) const {
-		/* remove character, we can do it regardless of position in a trie given we have distance */
-		if (length > 0 && distance > 0)
-			FindApprox(last, current, string + 1, length - 1, distance - 1, appender);
+		SetFrozen(nodes_storage_.data(), payloads_storage_.data(), labels_storage_.data(), nodes_storage_.size());
 
-		/* match */
-		if (length == 0 && last && last->data)
-			appender.Append(last);
+		root_ = NULL;
+		pool_.Clear();
+	}
 
-		/* we won't be able to proceed */
-		if (distance == 0 && length == 0)
-			return;
+	/* reconstructs mutable tree from the frozen array */
+	void Thaw() {
+		/* last mutable node of each frozen node's chain */
+		std::vector<node_type*> nodes(frozen_size_, NULL);
 
-		for (; current != NULL; current = current->next) {
-			/* normal path */
-			if (length > 0 && current->ch == *string)
-				FindApprox(current, current->child, string + 1, length - 1, distance, appender);
+		for (uint32_t i = 0; i + 1 < frozen_size_; ++i) {
+			node_type** tail = (i == 0) ? &root_ : &nodes[i]->child;
+			for (uint32_t child = frozen_nodes_[i].children; child != frozen_nodes_[i + 1].children; ++child) {
+				node_type* node = *tail = new(pool_.Allocate()) node_type(frozen_nodes_[child].ch);
+				tail = &node->next;
 
-			/* change character */
-			if (distance > 0 && length > 0 && current->ch != *string)
-				FindApprox(current, current->child, string + 1, length - 1, distance - 1, appender);
+				for (uint32_t offset = 1; offset < GetLabelLength(child); ++offset)
+					node = node->child = new(pool_.Allocate()) node_type(GetChar(child, offset + 1));
 
-			/* add character */
-			if (distance > 0)
-				FindApprox(current, current->child, string, length, distance - 1, appender);
+				node->payload = frozen_payloads_[child];
+				nodes[child] = node;
+			}
 		}
+
+		ReleaseFrozen();
+		frozen_ = false;
+	}
+
+	void SetFrozen(const frozen_node_type* nodes, const uint32_t* payloads, const Char* labels, uint32_t size) {
+		frozen_nodes_ = nodes;
+		frozen_payloads_ = payloads;
+		frozen_labels_ = labels;
+		frozen_size_ = size;
 	}
 
-	void Destroy(node_type* node) {
-		if (node->child)
-			Destroy(node->child);
-		if (node->next)
-			Destroy(node->next);
-		delete node;
+	void ReleaseFrozen() {
+		std::vector<frozen_node_type>().swap(nodes_storage_);
+		std::vector<uint32_t>().swap(payloads_storage_);
+		std::vector<Char>().swap(labels_storage_);
+		SetFrozen(NULL, NULL, NULL, 0);
 	}
 
 protected:
-	TrieBase() : root_(NULL) {
+	void EnsureFrozen() const {
+		if (!frozen_.load(std::memory_order_acquire))
+			const_cast<TrieBase*>(this)->Freeze();
+	}
+
+	/*
+	 * Positions in a frozen trie are pairs of node and number of its
+	 * label characters passed; the root is (0, 0). Positions are only
+	 * valid when the trie is frozen.
+	 */
+	uint32_t GetLabelLength(uint32_t node) const {
+		return frozen_nodes_[node + 1].label - frozen_nodes_[node].label;
+	}
+
+	/* last character passed to reach the position */
+	Char GetChar(uint32_t node, uint32_t offset) const {
+		return offset == 1 ? frozen_nodes_[node].ch : frozen_labels_[frozen_nodes_[node].label + offset - 1];
+	}
+
+	/* whether some key ends at the position */
+	bool IsFinal(uint32_t node, uint32_t offset) const {
+		return frozen_nodes_[node].data && offset == GetLabelLength(node);
+	}
+
+	/*
+	 * Whether some key under the position may be within distance
+	 * from a query which has given number of characters left
+	 */
+	bool MayMatch(uint32_t node, uint32_t offset, size_t restlength, int distance) const {
+		const frozen_node_type& current = frozen_nodes_[node];
+		const size_t labelrest = GetLabelLength(node) - offset;
+
+		if (restlength + distance < labelrest + current.minrest)
+			return false;
+		if (current.maxrest != frozen_node_type::MAX_REST && restlength > labelrest + current.maxrest + distance)
+			return false;
+		return true;
+	}
+
+	/* number unique for every position */
+	uint32_t GetPositionId(uint32_t node, uint32_t offset) const {
+		return frozen_nodes_[node].label + offset;
+	}
+
+	/*
+	 * Positions one character further from the given one, which are
+	 * nodes [first, last) at the same offset
+	 */
+	void GetNext(uint32_t node, uint32_t offset, uint32_t& first, uint32_t& last, uint32_t& nextoffset) const {
+		if (offset < GetLabelLength(node)) {
+			first = node;
+			last = node + 1;
+			nextoffset = offset + 1;
+		} else {
+			first = frozen_nodes_[node].children;
+			last = frozen_nodes_[node + 1].children;
+			nextoffset = 1;
+		}
+	}
+
+	/* advances position by the given character, if possible */
+	bool FindNext(uint32_t& node, uint32_t& offset, Char ch) const {
+		if (offset < GetLabelLength(node)) {
+			if (frozen_labels_[frozen_nodes_[node].label + offset] != ch)
+				return false;
+			++offset;
+			return true;
+		}
+
+		if (!FindChild(node, ch, node))
+			return false;
+		offset = 1;
+		return true;
+	}
+
+	TrieBase() : root_(NULL), frozen_nodes_(NULL), frozen_payloads_(NULL), frozen_labels_(NULL), frozen_size_(0), frozen_(false) {
 	}
 
 	~TrieBase() {
-		if (root_)
-			Destroy(root_);
+		/* nodes are released along with the pool */
 	}
 
-	void Insert(const Char* string, size_t length) {
-		if (length > 0)
-			Insert(NULL, &root_, string, length);
+	/*
+	 * Adds the key with given payload; if the key is already there,
+	 * its payload is kept. Returns the payload the key ends up with.
+	 */
+	uint32_t Insert(const Char* string, size_t length, uint32_t payload) {
+		if (frozen_)
+			Thaw();
+
+		if (length == 0)
+			return NO_PAYLOAD;
+
+		node_type** current = &root_;
+		for (;;) {
+			/* siblings are kept sorted by character */
+			for (; *current != NULL && (*current)->ch < *string; current = &((*current)->next)) {
+				/* empty */
+			}
+
+			if (*current == NULL || (*current)->ch != *string) {
+				node_type* node = new(pool_.Allocate()) node_type(*string);
+				node->next = *current;
+				*current = node;
+			}
+
+			if (--length == 0)
+				break;
+
+			current = &((*current)->child);
+			++string;
+		}
+
+		if ((*current)->payload == NO_PAYLOAD)
+			(*current)->payload = payload;
+
+		return (*current)->payload;
 	}
 
 	bool FindExact(const Char* string, size_t length) const {
-		if (length == 0 || !root_)
+		if (length == 0)
 			return false;
 
-		return FindExact(root_, string, length);
+		EnsureFrozen();
+
+		uint32_t node = 0, offset = 0;
+		for (; length > 0; ++string, --length)
+			if (!FindNext(node, offset, *string))
+				return false;
+
+		return IsFinal(node, offset);
 	}
 
+	/*
+	 * Passes every key within given edit distance from the string
+	 * to the appender. Edits are insertion, removal or change of a
+	 * character and swap of two adjacent characters. Same key may be
+	 * passed more than once for distance 1. Search stops early if
+	 * appender returns false.
+	 */
+	template<class Appender>
 	void FindApprox(const Char* string, size_t length, int distance, Appender& appender) const {
-		if (root_)
-			FindApprox(NULL, root_, string, length, distance, appender);
+		EnsureFrozen();
+
+		/* longest path is a full query with distance characters added */
+		std::vector<Char> path(length + distance + 1);
+
+		std::vector<SearchState> stack;
+		stack.reserve(64);
+		stack.push_back(SearchState(0, 0, 0, 0, distance));
+
+		/* with more than one edit, same states are reachable along
+		 * many edit paths (e.g. change vs. remove + add), so keep
+		 * track of visited ones */
+		const bool dedup = distance > 1;
+		StateSet visited;
+
+		while (!stack.empty()) {
+			const SearchState state = stack.back();
+			stack.pop_back();
+
+			const Char* rest = string + state.position;
+			const size_t restlength = length - state.position;
+
+			/* no key in the subtree has suitable length */
+			if (!MayMatch(state.node, state.offset, restlength, state.distance))
+				continue;
+
+			/* state already visited with no less distance left has covered
+			 * this one; states with no edits left are cheaper to walk again
+			 * than to track, so only their final nodes are checked */
+			bool first = true;
+			if (dedup && state.distance > 0) {
+				int seen = visited.Raise(GetPositionId(state.node, state.offset), state.position, state.distance);
+				if (seen >= state.distance)
+					continue;
+				first = seen < 0;
+			}
+
+			/* states are processed depth first, so path prefix up to this node is intact */
+			if (state.depth > 0)
+				path[state.depth - 1] = GetChar(state.node, state.offset);
+
+			/* ...except for transposition, which skips intermediate node */
+			if (state.transposed)
+				path[state.depth - 2] = string[state.position - 1];
+
+			/* no edits left: just follow the rest of the query */
+			if (state.distance == 0) {
+				uint32_t node = state.node, offset = state.offset;
+				uint32_t depth = state.depth;
+				bool found = true;
+				for (size_t i = 0; i < restlength && found; ++i) {
+					found = FindNext(node, offset, rest[i]);
+					path[depth++] = rest[i];
+				}
+
+				if (found && IsFinal(node, offset) && (!dedup || visited.Raise(GetPositionId(node, offset), length, 0) < 0)) {
+					if (!appender.Append(path.data(), depth, frozen_payloads_[node]))
+						return;
+				}
+
+				continue;
+			}
+
+			/* remove character, we can do it regardless of position in a trie given we have distance */
+			if (restlength > 0)
+				stack.push_back(SearchState(state.node, state.offset, state.position + 1, state.depth, state.distance - 1));
+
+			/* match */
+			if (restlength == 0 && IsFinal(state.node, state.offset) && first) {
+				if (!appender.Append(path.data(), state.depth, frozen_payloads_[state.node]))
+					return;
+			}
+
+			uint32_t next, end, offset;
+			GetNext(state.node, state.offset, next, end, offset);
+			for (; next != end; ++next) {
+				const Char ch = GetChar(next, offset);
+
+				if (restlength > 0) {
+					if (ch == *rest) {
+						/* normal path */
+						stack.push_back(SearchState(next, offset, state.position + 1, state.depth + 1, state.distance));
+					} else {
+						/* change character */
+						stack.push_back(SearchState(next, offset, state.position + 1, state.depth + 1, state.distance - 1));
+
+						/* swap adjacent characters */
+						uint32_t swapnode = next, swapoffset = offset;
+						if (restlength > 1 && ch == rest[1] && FindNext(swapnode, swapoffset, rest[0]))
+							stack.push_back(SearchState(swapnode, swapoffset, state.position + 2, state.depth + 2, state.distance - 1, true));
+					}
+				}
+
+				/* add character */
+				stack.push_back(SearchState(next, offset, state.position, state.depth + 1, state.distance - 1));
+			}
+		}
 	}
-};
 
+	/*
+	 * Same as FindApprox, but instead of branching on every possible
+	 * edit, walks the trie in lockstep with Levenshtein automaton for
+	 * the query, simulated by rows of edit distance matrix (one row
+	 * per trie level). Subtrees are cut as soon as no cell in the row
+	 * is within distance, so the cost doesn't explode with distance.
+	 * Like FindApprox, counts swap of adjacent characters as a single
+	 * edit (restricted Damerau-Levenshtein distance).
+	 */
+	template<class Appender>
+	void FindApproxAutomaton(const Char* string, size_t length, int distance, Appender& appender) const {
+		EnsureFrozen();
+
+		/* cells are capped at this value, as anything above distance is equally unreachable */
+		const int unreachable = distance + 1;
+		const size_t width = length + 1;
+		const size_t maxdepth = length + distance;
+
+		std::vector<Char> path(maxdepth + 1);
+		std::vector<int> rows(width * (maxdepth + 1));
+
+		for (size_t j = 0; j < width; ++j)
+			rows[j] = std::min((int)j, unreachable);
+
+		/* positions along with their depths, depth first order keeps parent rows intact */
+		struct Pending {
+			uint32_t node;
+			uint32_t offset;
+			uint32_t depth;
+
+			Pending(uint32_t n, uint32_t o, uint32_t d) : node(n), offset(o), depth(d) {
+			}
+		};
+
+		/* no key is within reach (e.g. empty query with zero distance), and
+		 * rows have no room for any */
+		if (maxdepth == 0)
+			return;
+
+		std::vector<Pending> stack;
+		stack.reserve(64);
+
+		for (uint32_t child = frozen_nodes_[0].children; child != frozen_nodes_[1].children; ++child)
+			stack.push_back(Pending(child, 1, 1));
+
+		while (!stack.empty()) {
+			const Pending current = stack.back();
+			stack.pop_back();
+
+			const uint32_t depth = current.depth;
+			const Char ch = GetChar(current.node, current.offset);
+			path[depth - 1] = ch;
+
+			const int* prev = &rows[(depth - 1) * width];
+			int* row = &rows[depth * width];
+
+			/* only cells within distance from the diagonal may be reachable */
+			const size_t lo = depth > (size_t)distance ? depth - distance : 0;
+			const size_t hi = std::min(length, (size_t)depth + distance);
+
+			/* cells bordering the band are read by this and the next row */
+			if (lo > 0)
+				row[lo - 1] = unreachable;
+			if (hi < length)
+				row[hi + 1] = unreachable;
+
+			int rowmin = unreachable;
+			for (size_t j = lo; j <= hi; ++j) {
+				int cell = prev[j] + 1;
+				if (j > 0) {
+					cell = std::min(cell, row[j - 1] + 1);
+					cell = std::min(cell, prev[j - 1] + (string[j - 1] == ch ? 0 : 1));
+				}
+				if (j > 1 && depth > 1 && string[j - 1] == path[depth - 2] && string[j - 2] == ch)
+					cell = std::min(cell, rows[(depth - 2) * width + j - 2] + 1);
+				row[j] = cell = std::min(cell, unreachable);
+				rowmin = std::min(rowmin, cell);
+			}
+
+			if (hi == length && row[length] <= distance && IsFinal(current.node, current.offset)) {
+				if (!appender.Append(path.data(), depth, frozen_payloads_[current.node]))
+					return;
+			}
+
+			if (rowmin > distance || depth == maxdepth)
+				continue;
+
+			uint32_t next, end, offset;
+			GetNext(current.node, current.offset, next, end, offset);
+			for (; next != end; ++next)
+				stack.push_back(Pending(next, offset, depth + 1));
+		}
+	}
+
+	/*
+	 * Same as FindApproxAutomaton, but for a batch of queries, which
+	 * are walked through the trie together, so every node is visited
+	 * once for all queries which may still match below it. Only the
+	 * walk is shared: each query still computes its own automaton
+	 * rows. Queries are taken in chunks of BATCH_CHUNK, which bounds
+	 * memory used for the rows. Found keys are passed to appender's
+	 * Append along with the query index; returning false stops search
+	 * for that query only.
+	 */
+	template<class Appender>
+	void FindApproxBatch(const Char* const* strings, const size_t* lengths, size_t count, int distance, Appender& appender) const {
+		EnsureFrozen();
+
+		const int unreachable = distance + 1;
+
+		std::vector<size_t> rowsoffsets;
+		std::vector<Char> path;
+		std::vector<int> rows;
+		std::vector<bool> stopped;
+
+		/* queries which may match below a position; lists are kept in
+		 * one array, and a list of any pending position stays intact
+		 * until its subtree is walked */
+		std::vector<uint32_t> active;
+
+		struct Pending {
+			uint32_t node;
+			uint32_t offset;
+			uint32_t depth;
+			uint32_t first;  /* range of active queries */
+			uint32_t last;
+
+			Pending(uint32_t n, uint32_t o, uint32_t d, uint32_t f, uint32_t l) : node(n), offset(o), depth(d), first(f), last(l) {
+			}
+		};
+
+		std::vector<Pending> stack;
+		stack.reserve(64);
+
+		for (size_t base = 0; base < count; base += BATCH_CHUNK) {
+			const size_t chunk = std::min(count - base, (size_t)BATCH_CHUNK);
+
+			/* matrices of chunk queries are laid back to back */
+			rowsoffsets.assign(chunk + 1, 0);
+			size_t maxdepth = 0;
+			for (size_t q = 0; q < chunk; ++q) {
+				rowsoffsets[q + 1] = rowsoffsets[q] + (lengths[base + q] + 1) * (lengths[base + q] + distance + 1);
+				maxdepth = std::max(maxdepth, lengths[base + q] + distance);
+			}
+
+			path.resize(maxdepth + 1);
+			rows.resize(rowsoffsets[chunk]);
+			stopped.assign(chunk, false);
+
+			active.clear();
+			for (size_t q = 0; q < chunk; ++q) {
+				for (size_t j = 0; j <= lengths[base + q]; ++j)
+					rows[rowsoffsets[q] + j] = std::min((int)j, unreachable);
+				active.push_back(q);
+			}
+
+			for (uint32_t child = frozen_nodes_[0].children; child != frozen_nodes_[1].children; ++child)
+				stack.push_back(Pending(child, 1, 1, 0, active.size()));
+
+			while (!stack.empty()) {
+				const Pending current = stack.back();
+				stack.pop_back();
+
+				/* lists of already walked subtrees are no longer needed */
+				active.resize(current.last);
+
+				const uint32_t depth = current.depth;
+				const Char ch = GetChar(current.node, current.offset);
+				path[depth - 1] = ch;
+
+				const bool final = IsFinal(current.node, current.offset);
+
+				for (uint32_t a = current.first; a != current.last; ++a) {
+					const uint32_t q = active[a];
+					const Char* string = strings[base + q];
+					const size_t length = lengths[base + q];
+					const size_t width = length + 1;
+
+					if (stopped[q] || depth > length + distance)
+						continue;
+
+					const int* prev = &rows[rowsoffsets[q] + (depth - 1) * width];
+					int* row = &rows[rowsoffsets[q] + depth * width];
+
+					/* only cells within distance from the diagonal may be reachable */
+					const size_t lo = depth > (size_t)distance ? depth - distance : 0;
+					const size_t hi = std::min(length, (size_t)depth + distance);
+
+					/* cells bordering the band are read by this and the next row */
+					if (lo > 0)
+						row[lo - 1] = unreachable;
+					if (hi < length)
+						row[hi + 1] = unreachable;
+
+					int rowmin = unreachable;
+					for (size_t j = lo; j <= hi; ++j) {
+						int cell = prev[j] + 1;
+						if (j > 0) {
+							cell = std::min(cell, row[j - 1] + 1);
+							cell = std::min(cell, prev[j - 1] + (string[j - 1] == ch ? 0 : 1));
+						}
+						if (j > 1 && depth > 1 && string[j - 1] == path[depth - 2] && string[j - 2] == ch)
+							cell = std::min(cell, rows[rowsoffsets[q] + (depth - 2) * width + j - 2] + 1);
+						row[j] = cell = std::min(cell, unreachable);
+						rowmin = std::min(rowmin, cell);
+					}
+
+					if (final && hi == length && row[length] <= distance && !appender.Append(base + q, path.data(), depth, frozen_payloads_[current.node])) {
+						stopped[q] = true;
+						continue;
+					}
+
+					if (rowmin <= distance)
+						active.push_back(q);
+				}
+
+				if (active.size() == current.last)
+					continue;
+
+				uint32_t next, end, offset;
+				GetNext(current.node, current.offset, next, end, offset);
+				for (; next != end; ++next)
+					stack.push_back(Pending(next, offset, depth + 1, current.last, active.size()));
+			}
+		}
+	}
+
+public:
+	/*
+	 * Compacts the trie into immutable contiguous layout used for
+	 * lookups. This is done implicitly on first lookup after any
+	 * modification, but may be called explicitly after filling the
+	 * trie to take the cost out of the lookup path. Inserting into
+	 * frozen trie is still possible, but is expensive as it unpacks
+	 * the trie back. Lookups may run concurrently, insertions may not.
+	 */
+	void Freeze() {
+		std::lock_guard<std::mutex> lock(freeze_mutex_);
+		if (!frozen_.load(std::memory_order_relaxed)) {
+			DoFreeze();
+			frozen_.store(true, std::memory_order_release);
+		}
+	}
+
+	/*
+	 * Writes frozen trie as a position independent image, which
+	 * may later be used in place with MapImage. Image is only
+	 * readable on machines with the same byte order.
+	 */
+	void WriteImage(std::ostream& out) const {
+		EnsureFrozen();
+
+		ImageHeader header = ImageHeader();
+		std::copy(ImageMagic(), ImageMagic() + sizeof(header.magic), header.magic);
+		header.byteorder = IMAGE_BYTEORDER;
+		header.charsize = sizeof(Char);
+		header.nodesize = sizeof(frozen_node_type);
+		header.nodes = frozen_size_;
+		header.labels = frozen_nodes_[frozen_size_ - 1].label;
+
+		out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+		/* nodes are copied field by field into zeroed buffer, so that
+		 * padding is not written out and equal tries give equal images */
+		static const size_t chunk = 1024;
+		std::vector<char> buffer(sizeof(frozen_node_type) * chunk);
+		for (uint32_t first = 0; first < header.nodes; first += chunk) {
+			const uint32_t last = std::min(header.nodes, first + (uint32_t)chunk);
+
+			std::fill(buffer.begin(), buffer.end(), 0);
+			for (uint32_t i = first; i < last; ++i) {
+				frozen_node_type* node = reinterpret_cast<frozen_node_type*>(buffer.data()) + (i - first);
+				node->children = frozen_nodes_[i].children;
+				node->label = frozen_nodes_[i].label;
+				node->ch = frozen_nodes_[i].ch;
+				node->data = frozen_nodes_[i].data;
+				node->minrest = frozen_nodes_[i].minrest;
+				node->maxrest = frozen_nodes_[i].maxrest;
+			}
+
+			out.write(buffer.data(), sizeof(frozen_node_type) * (last - first));
+		}
+
+		out.write(reinterpret_cast<const char*>(frozen_payloads_), sizeof(uint32_t) * header.nodes);
+		out.write(reinterpret_cast<const char*>(frozen_labels_), sizeof(Char) * header.labels);
+	}
+
+	/* size of the image written by WriteImage */
+	size_t GetImageSize() const {
+		EnsureFrozen();
+
+		return sizeof(ImageHeader) + (sizeof(frozen_node_type) + sizeof(uint32_t)) * frozen_size_ + sizeof(Char) * frozen_nodes_[frozen_size_ - 1].label;
+	}
+
+	/* number of nodes of frozen trie, not counting the sentinel */
+	size_t GetNodeCount() const {
+		EnsureFrozen();
+
+		return frozen_size_ - 1;
+	}
+
+	/* number of characters in labels of frozen trie */
+	size_t GetLabelCount() const {
+		EnsureFrozen();
+
+		return frozen_nodes_[frozen_size_ - 1].label;
+	}
+
+	/* bytes of mutable nodes and owned frozen arrays; mapped image is not counted */
+	size_t GetMemoryUsage() const {
+		return pool_.GetMemoryUsage() +
+			nodes_storage_.capacity() * sizeof(frozen_node_type) +
+			payloads_storage_.capacity() * sizeof(uint32_t) +
+			labels_storage_.capacity() * sizeof(Char);
+	}
+
+	/*
+	 * Counts nodes of frozen trie by number of children (fanout[n] is
+	 * number of nodes with n children) and by depth in nodes from the
+	 * root (depth[0] is 1 for the root). As chains are collapsed,
+	 * depth in nodes may be smaller than length of keys
+	 */
+	void GetShape(std::vector<size_t>& fanout, std::vector<size_t>& depth) const {
+		EnsureFrozen();
+
+		fanout.clear();
+		depth.clear();
+
+		std::vector<uint32_t> depths(frozen_size_ - 1, 0);
+		for (uint32_t i = 0; i + 1 < frozen_size_; ++i) {
+			const uint32_t children = frozen_nodes_[i + 1].children - frozen_nodes_[i].children;
+
+			if (fanout.size() <= children)
+				fanout.resize(children + 1);
+			++fanout[children];
+
+			if (depth.size() <= depths[i])
+				depth.resize(depths[i] + 1);
+			++depth[depths[i]];
+
+			for (uint32_t child = frozen_nodes_[i].children; child != frozen_nodes_[i + 1].children; ++child)
+				depths[child] = depths[i] + 1;
+		}
+	}
+
+	/*
+	 * Replaces trie contents with an image written by WriteImage,
+	 * which is used in place without copying (e.g. from a read only
+	 * memory mapping) and must outlive the trie or the next
+	 * insertion into it. Returns false if the image is malformed or
+	 * incompatible, or has payloads not below payload_limit, leaving
+	 * the trie unchanged.
+	 */
+	bool MapImage(const void* data, size_t size, uint32_t payload_limit = NO_PAYLOAD) {
+		if (size < sizeof(ImageHeader) || reinterpret_cast<uintptr_t>(data) % alignof(frozen_node_type) != 0)
+			return false;
+
+		const ImageHeader* header = static_cast<const ImageHeader*>(data);
+		if (!std::equal(header->magic, header->magic + sizeof(header->magic), ImageMagic()) ||
+				header->byteorder != IMAGE_BYTEORDER ||
+				header->charsize != sizeof(Char) ||
+				header->nodesize != sizeof(frozen_node_type) ||
+				header->nodes < 2 ||
+				size != sizeof(ImageHeader) + (sizeof(frozen_node_type) + sizeof(uint32_t)) * (size_t)header->nodes + sizeof(Char) * (size_t)header->labels)
+			return false;
+
+		const frozen_node_type* nodes = reinterpret_cast<const frozen_node_type*>(header + 1);
+		const uint32_t* payloads = reinterpret_cast<const uint32_t*>(nodes + header->nodes);
+		const Char* labels = reinterpret_cast<const Char*>(payloads + header->nodes);
+
+		/* children and label ranges must be ordered and in bounds for searches to be safe */
+		if (nodes[0].label != 0 || nodes[1].label != 0 || nodes[header->nodes - 1].label != header->labels)
+			return false;
+		for (uint32_t i = 0; i + 1 < header->nodes; ++i) {
+			if (nodes[i].children <= i || nodes[i].children > nodes[i + 1].children || nodes[i + 1].children > header->nodes - 1)
+				return false;
+			if (i > 0 && nodes[i].label >= nodes[i + 1].label)
+				return false;
+		}
+
+		/* keys end exactly where payloads are */
+		for (uint32_t i = 0; i < header->nodes; ++i) {
+			if (nodes[i].data != (payloads[i] != NO_PAYLOAD))
+				return false;
+			if (nodes[i].data && payloads[i] >= payload_limit)
+				return false;
+		}
+
+		std::lock_guard<std::mutex> lock(freeze_mutex_);
+
+		ReleaseFrozen();
+		root_ = NULL;
+		pool_.Clear();
+
+		SetFrozen(nodes, payloads, labels, header->nodes);
+		frozen_.store(true, std::memory_order_release);
+
+		return true;
+	}
+};
 }
 
 #endif
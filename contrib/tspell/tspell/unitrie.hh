@@ -21,6 +21,7 @@
 #define TSPELL_UNITRIE_HH
 
 #include <set>
+#include <vector>
 
 #include <unicode/unistr.h>
 
@@ -30,8 +31,6 @@ namespace TSpell {
 
 class UnicodeStringSetAppender {
 public:
-	typedef Node<UChar> node_type;
-
 	typedef std::set<icu::UnicodeString> set_type;
 
 private:
@@ -41,23 +40,19 @@ public:
 	UnicodeStringSetAppender(set_type& set) : set_(set) {
 	}
 
-	void Append(const node_type* node) {
-		icu::UnicodeString str;
-		for (const node_type* cur = node; cur; cur = cur->parent)
-			str += cur->ch;
-		str.reverse();
-
-		set_.insert(str);
+	bool Append(const UChar* string, size_t length, uint32_t) {
+		set_.insert(icu::UnicodeString(string, (int32_t)length));
+		return true;
 	}
 };
 
-class UnicodeTrie : public TrieBase<UChar, UnicodeStringSetAppender> {
+class UnicodeTrie : public TrieBase<UChar> {
 private:
-	typedef TrieBase<UChar, UnicodeStringSetAppender> base_type;
+	typedef TrieBase<UChar> base_type;
 
 public:
-	void Insert(const icu::UnicodeString& string) {
-		base_type::Insert(string.getBuffer(), string.length());
+	uint32_t Insert(const icu::UnicodeString& string, uint32_t payload = 0) {
+		return base_type::Insert(string.getBuffer(), string.length(), payload);
 	}
 
 	bool FindExact(const icu::UnicodeString& string) const {
@@ -68,6 +63,45 @@ public:
 		UnicodeStringSetAppender a(out);
 		base_type::FindApprox(string.getBuffer(), string.length(), distance, a);
 	}
+
+	void FindApproxAutomaton(const icu::UnicodeString& string, int distance, std::set<icu::UnicodeString>& out) const {
+		UnicodeStringSetAppender a(out);
+		base_type::FindApproxAutomaton(string.getBuffer(), string.length(), distance, a);
+	}
+
+	void FindApprox(const icu::UnicodeString& string, int distance, std::vector<uint32_t>& out) const {
+		PayloadAppender a(out);
+		base_type::FindApprox(string.getBuffer(), string.length(), distance, a);
+	}
+
+	void FindApproxAutomaton(const icu::UnicodeString& string, int distance, std::vector<uint32_t>& out) const {
+		PayloadAppender a(out);
+		base_type::FindApproxAutomaton(string.getBuffer(), string.length(), distance, a);
+	}
+
+	template<class Appender>
+	void FindApprox(const icu::UnicodeString& string, int distance, Appender& appender) const {
+		base_type::FindApprox(string.getBuffer(), string.length(), distance, appender);
+	}
+
+	template<class Appender>
+	void FindApproxAutomaton(const icu::UnicodeString& string, int distance, Appender& appender) const {
+		base_type::FindApproxAutomaton(string.getBuffer(), string.length(), distance, appender);
+	}
+
+	template<class Appender>
+	void FindApproxBatch(const std::vector<icu::UnicodeString>& strings, int distance, Appender& appender) const {
+		std::vector<const UChar*> buffers;
+		std::vector<size_t> lengths;
+		buffers.reserve(strings.size());
+		lengths.reserve(strings.size());
+		for (std::vector<icu::UnicodeString>::const_iterator string = strings.begin(); string != strings.end(); ++string) {
+			buffers.push_back(string->getBuffer());
+			lengths.push_back(string->length());
+		}
+
+		base_type::FindApproxBatch(buffers.data(), lengths.data(), strings.size(), distance, appender);
+	}
 };
 
 }
@@ -0,0 +1,271 @@
+/*
+ * Copyright (C) 2011 Dmitry Marakasov
+ *
+ * This file is part of tspell.
+ *
+ * tspell is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * tspell is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with tspell.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef TSPELL_UTF8TRIE_HH
+#define TSPELL_UTF8TRIE_HH
+
+#include <algorithm>
+#include <string>
+#include <set>
+#include <vector>
+
+#include <tspell/stringtrie.hh>
+
+namespace TSpell {
+
+/*
+ * Trie of UTF-8 strings
+ *
+ * Keys are stored byte by byte, but approximate search treats
+ * multibyte sequences as single characters, so results match those
+ * of a trie of decoded strings. Malformed sequences are treated as
+ * separate bytes, both in keys and in queries.
+ */
+class Utf8Trie : public TrieBase<char> {
+private:
+	typedef TrieBase<char> base_type;
+
+	/* bytes in sequence started by given byte; 0 for continuation byte */
+	static int SequenceLength(unsigned char byte) {
+		if (byte < 0x80)
+			return 1;
+		if (byte < 0xc0)
+			return 0;
+		if (byte < 0xe0)
+			return 2;
+		if (byte < 0xf0)
+			return 3;
+		if (byte < 0xf8)
+			return 4;
+		return 0;
+	}
+
+	/* malformed bytes get values out of unicode range */
+	static uint32_t StrayByte(unsigned char byte) {
+		return 0x80000000U | byte;
+	}
+
+	/* pending position of the search */
+	struct SearchState {
+		uint32_t node;       /* position to process */
+		uint32_t offset;
+		uint32_t depth;      /* number of path bytes, including the position */
+		uint32_t chars;      /* number of complete characters before the position */
+		uint32_t ch;         /* bits of character being decoded */
+		int pending;         /* bytes left to complete the character */
+		uint32_t start;      /* path index of the first byte of the character */
+
+		SearchState(uint32_t n, uint32_t o, uint32_t d, uint32_t c, uint32_t h = 0, int p = 0, uint32_t s = 0) : node(n), offset(o), depth(d), chars(c), ch(h), pending(p), start(s) {
+		}
+	};
+
+	static void Decode(const char* string, size_t length, std::vector<uint32_t>& out) {
+		const unsigned char* bytes = reinterpret_cast<const unsigned char*>(string);
+
+		for (size_t i = 0; i < length; ) {
+			const int seqlength = SequenceLength(bytes[i]);
+
+			uint32_t ch = seqlength == 1 ? bytes[i] : bytes[i] & (0x7f >> seqlength);
+			int j = 1;
+			for (; j < seqlength && i + j < length && (bytes[i + j] & 0xc0) == 0x80; ++j)
+				ch = (ch << 6) | (bytes[i + j] & 0x3f);
+
+			if (seqlength == 0 || j < seqlength) {
+				out.push_back(StrayByte(bytes[i]));
+				++i;
+			} else {
+				out.push_back(ch);
+				i += seqlength;
+			}
+		}
+	}
+
+public:
+	uint32_t Insert(const std::string& string, uint32_t payload = 0) {
+		return base_type::Insert(string.data(), string.length(), payload);
+	}
+
+	bool FindExact(const std::string& string) const {
+		return base_type::FindExact(string.data(), string.length());
+	}
+
+	/*
+	 * Passes every key within given edit distance (see
+	 * TrieBase::FindApproxAutomaton) from the string to the appender,
+	 * counting edits in characters rather than bytes
+	 */
+	template<class Appender>
+	void FindApprox(const char* string, size_t length, int distance, Appender& appender) const {
+		EnsureFrozen();
+
+		std::vector<uint32_t> query;
+		query.reserve(length);
+		Decode(string, length, query);
+
+		const size_t querylength = query.size();
+
+		/* cells are capped at this value, as anything above distance is equally unreachable */
+		const int unreachable = distance + 1;
+		const size_t width = querylength + 1;
+		const size_t maxchars = querylength + distance;
+
+		std::vector<char> path((maxchars + 1) * 4);
+		std::vector<uint32_t> chars(maxchars + 1);
+		std::vector<int> rows(width * (maxchars + 1));
+
+		for (size_t j = 0; j < width; ++j)
+			rows[j] = std::min((int)j, unreachable);
+
+		/* adds character after depth complete ones and computes its
+		 * row; returns whether anything is reachable through it */
+		auto advance = [&](size_t& depth, uint32_t ch) -> bool {
+			chars[depth++] = ch;
+
+			const int* prev = &rows[(depth - 1) * width];
+			int* row = &rows[depth * width];
+
+			/* only cells within distance from the diagonal may be reachable */
+			const size_t lo = depth > (size_t)distance ? depth - distance : 0;
+			const size_t hi = std::min(querylength, depth + distance);
+
+			/* cells bordering the band are read by this and the next row */
+			if (lo > 0)
+				row[lo - 1] = unreachable;
+			if (hi < querylength)
+				row[hi + 1] = unreachable;
+
+			int rowmin = unreachable;
+			for (size_t j = lo; j <= hi; ++j) {
+				int cell = prev[j] + 1;
+				if (j > 0) {
+					cell = std::min(cell, row[j - 1] + 1);
+					cell = std::min(cell, prev[j - 1] + (query[j - 1] == ch ? 0 : 1));
+				}
+				if (j > 1 && depth > 1 && query[j - 1] == chars[depth - 2] && query[j - 2] == ch)
+					cell = std::min(cell, rows[(depth - 2) * width + j - 2] + 1);
+				row[j] = cell = std::min(cell, unreachable);
+				rowmin = std::min(rowmin, cell);
+			}
+
+			return rowmin <= distance;
+		};
+
+		/* same as advance for each of given path bytes, as Decode
+		 * does with bytes of incomplete sequence */
+		auto advancestray = [&](size_t& depth, uint32_t first, uint32_t last) -> bool {
+			for (uint32_t i = first; i != last; ++i)
+				if (depth == maxchars || !advance(depth, StrayByte(path[i])))
+					return false;
+			return true;
+		};
+
+		auto matches = [&](size_t depth) -> bool {
+			return depth + distance >= querylength && rows[depth * width + querylength] <= distance;
+		};
+
+		/* depth first order keeps parent rows intact: pending states
+		 * never have more complete characters than the current one, and
+		 * rows are only written past them */
+		std::vector<SearchState> stack;
+		stack.reserve(64);
+
+		for (uint32_t child = frozen_nodes_[0].children; child != frozen_nodes_[1].children; ++child)
+			stack.push_back(SearchState(child, 1, 1, 0));
+
+		while (!stack.empty()) {
+			SearchState state = stack.back();
+			stack.pop_back();
+
+			size_t depth = state.chars;
+
+			/* no character may be added at all */
+			if (depth == maxchars)
+				continue;
+
+			const unsigned char byte = GetChar(state.node, state.offset);
+			path[state.depth - 1] = byte;
+
+			/* sequence broken by this byte decodes to separate bytes */
+			if (state.pending > 0 && (byte & 0xc0) != 0x80) {
+				if (!advancestray(depth, state.start, state.depth - 1) || depth == maxchars)
+					continue;
+				state.pending = 0;
+			}
+
+			/* decode character; rows are only computed for complete ones */
+			if (state.pending == 0) {
+				const int seqlength = SequenceLength(byte);
+				if (seqlength <= 1) {
+					state.ch = seqlength == 1 ? byte : StrayByte(byte);
+				} else {
+					state.ch = byte & (0x7f >> seqlength);
+					state.pending = seqlength - 1;
+					state.start = state.depth - 1;
+				}
+			} else {
+				state.ch = (state.ch << 6) | (byte & 0x3f);
+				--state.pending;
+			}
+
+			uint32_t next, end, offset;
+			GetNext(state.node, state.offset, next, end, offset);
+
+			if (state.pending > 0) {
+				/* key ending inside a sequence decodes to separate bytes as well */
+				if (IsFinal(state.node, state.offset)) {
+					size_t straydepth = depth;
+					if (advancestray(straydepth, state.start, state.depth) && matches(straydepth) &&
+							!appender.Append(path.data(), state.depth, frozen_payloads_[state.node]))
+						return;
+				}
+
+				for (; next != end; ++next)
+					stack.push_back(SearchState(next, offset, state.depth + 1, depth, state.ch, state.pending, state.start));
+				continue;
+			}
+
+			const bool reachable = advance(depth, state.ch);
+
+			if (IsFinal(state.node, state.offset) && matches(depth)) {
+				if (!appender.Append(path.data(), state.depth, frozen_payloads_[state.node]))
+					return;
+			}
+
+			if (!reachable || depth == maxchars)
+				continue;
+
+			for (; next != end; ++next)
+				stack.push_back(SearchState(next, offset, state.depth + 1, depth));
+		}
+	}
+
+	void FindApprox(const std::string& string, int distance, std::set<std::string>& out) const {
+		StringSetAppender<char> a(out);
+		FindApprox(string.data(), string.length(), distance, a);
+	}
+
+	void FindApprox(const std::string& string, int distance, std::vector<uint32_t>& out) const {
+		PayloadAppender a(out);
+		FindApprox(string.data(), string.length(), distance, a);
+	}
+};
+
+}
+
+#endif
@@ -18,12 +18,14 @@
  */
 
 #include <set>
-#include <map>
-#include <unordered_set>
 #include <unordered_map>
 
 #include <string>
 #include <stdexcept>
+#include <fstream>
+#include <sstream>
+#include <thread>
+#include <exception>
 #include <vector>
 #include <algorithm>
 
@@ -36,6 +38,13 @@
 #include <unicode/uchar.h>
 
 #include <tspell/unitrie.hh>
+#include <tspell/deletionindex.hh>
+#include <tspell/bktree.hh>
+#include <tspell/flatmultimap.hh>
+#include <tspell/stringpool.hh>
+#include <tspell/image.hh>
+#include <tspell/mappedfile.hh>
+#include <tspell/shardedcache.hh>
 
 #include <streetmangler/database.hh>
 #include <streetmangler/locale.hh>
@@ -53,12 +62,13 @@ namespace {
 		return (olddist < 0 || (newdist >= 0 && newdist < olddist)) ? newdist : olddist;
 	}
 
+	/* collects names from the file and files it includes */
 	class DatabaseLoader : public StreetMangler::StringListParser {
 	private:
-		StreetMangler::Database& database_;
+		std::vector<std::string>& names_;
 
 	public:
-		DatabaseLoader(const std::string& filename, StreetMangler::Database& database) : StreetMangler::StringListParser(filename), database_(database) {
+		DatabaseLoader(const std::string& filename, std::vector<std::string>& names) : StreetMangler::StringListParser(filename), names_(names) {
 		}
 
 		void ProcessString(const std::string& string) {
@@ -78,11 +88,11 @@ namespace {
 					newname += string.substr(filepos);
 				}
 
-				DatabaseLoader recursive_loader(newname, database_);
+				DatabaseLoader recursive_loader(newname, names_);
 				recursive_loader.Parse();
 			} else {
 				/* process name */
-				database_.Add(string);
+				names_.push_back(string);
 			}
 		}
 	};
@@ -93,7 +103,11 @@ namespace StreetMangler {
 class Database::Private {
 	friend class Database;
 protected:
-	Private(const Locale& locale) : locale_(locale) {
+	Private(const Locale& locale, SpellingEngine engine, int index_depth) : locale_(locale), engine_(engine), load_threads_(0) {
+		if (engine_ == ENGINE_DELETIONS)
+			deletion_index_.reset(new TSpell::DeletionIndex<UChar>(index_depth));
+		if (engine_ == ENGINE_BKTREE)
+			bk_tree_.reset(new TSpell::BKTree<UChar>);
 	}
 
 	const Locale& GetLocale() const {
@@ -195,29 +209,483 @@ protected:
 		if (realdepth == 1 && shorterdiff.length() == 1 && longerdiff.length() == 1 && shorterdiff[0] == g_yo[0] && longerdiff[0] == g_ye[0])
 			return 0;
 
-		/* count swapped adjacent letters as a single typo */
-		if (realdepth == 2 && shorterdiff.length() == 2 && longerdiff.length() == 2 && shorterdiff[0] == longerdiff[1] && shorterdiff[1] == longerdiff[0])
-			return 1;
-
 		return realdepth;
 	}
 
+	/* everything needed to add a name to indexes */
+	struct PreparedName {
+		std::vector<std::string> canonicals;
+		std::string hash;
+		icu::UnicodeString uhashordered;
+		icu::UnicodeString uhashunordered;
+		icu::UnicodeString stripped; /* empty if same as uhashordered */
+	};
+
+	/* doesn't touch indexes, so may run in parallel with other preparations */
+	void PrepareName(const std::string& name, PreparedName& prepared) const {
+		Name tokenized(name, locale_);
+
+		NameToHashes(tokenized, &prepared.hash, nullptr, &prepared.uhashordered, &prepared.uhashunordered);
+
+		/* for the locales in which canonical form != full form,
+		 * we need to use canonical form as a reference
+		 *
+		 * XXX: this has a side effect of ignoring special writing
+		 * of status part from the database (e.g. "Русская Слобода" is
+		 * converted to "Русская слобода"). May handle canonical form ==
+		 * full form case specially just using variant from the database */
+		std::set<std::string> canonical_part_variants;
+
+		/* default canonical variant */
+		if (tokenized.GetStatusFlags() & Locale::STATUS_AT_LEFT)
+			canonical_part_variants.insert(tokenized.Join(Name::CANONICALIZE_STATUS|Name::STATUS_TO_LEFT));
+		else if (tokenized.GetStatusFlags() & Locale::STATUS_AT_RIGHT)
+			canonical_part_variants.insert(tokenized.Join(Name::CANONICALIZE_STATUS|Name::STATUS_TO_RIGHT));
+		else
+			canonical_part_variants.insert(tokenized.Join(Name::CANONICALIZE_STATUS));
+
+		/* additional canonical variants, which may be enabled depending on flags */
+		if (tokenized.IsStatusPartAtLeft() && (tokenized.GetStatusFlags() & Locale::ORDER_RANDOM_IF_LEFT))
+			canonical_part_variants.insert(tokenized.Join(Name::CANONICALIZE_STATUS|Name::STATUS_TO_RIGHT));
+
+		if (tokenized.IsStatusPartAtRight() && (tokenized.GetStatusFlags() & Locale::ORDER_RANDOM_IF_RIGHT))
+			canonical_part_variants.insert(tokenized.Join(Name::CANONICALIZE_STATUS|Name::STATUS_TO_LEFT));
+
+		prepared.canonicals.assign(canonical_part_variants.begin(), canonical_part_variants.end());
+
+		/* for stripped status */
+		NameToHashes(tokenized, nullptr, nullptr, &prepared.stripped, nullptr, Name::REMOVE_ALL_STATUSES);
+		prepared.stripped.findAndReplace(g_yo, g_ye);
+		if (prepared.stripped == prepared.uhashordered)
+			prepared.stripped.remove();
+	}
+
+	/* the following add prepared names with given ids to single
+	 * kind of indexes, so different kinds may be filled in parallel */
+	void AddCanonicalMap(const PreparedName& prepared, const uint32_t* ids) {
+		for (size_t i = 0; i < prepared.canonicals.size(); ++i)
+			canonical_map_.Insert(prepared.hash.data(), prepared.hash.length(), ids[i]);
+	}
+
+	void AddStrippedMap(const PreparedName& prepared, const uint32_t* ids) {
+		if (prepared.stripped.isEmpty())
+			return;
+
+		for (size_t i = 0; i < prepared.canonicals.size(); ++i)
+			stripped_map_.Insert(prepared.stripped.getBuffer(), prepared.stripped.length(), ids[i]);
+	}
+
+	void AddNameSpellings(const PreparedName& prepared, const uint32_t* ids) {
+		for (size_t i = 0; i < prepared.canonicals.size(); ++i) {
+			AddSpelling(prepared.uhashordered, ids[i]);
+			if (prepared.uhashunordered != prepared.uhashordered)
+				AddSpelling(prepared.uhashunordered, ids[i]);
+		}
+	}
+
+	void AddPreparedName(const PreparedName& prepared) {
+		/* for exact match; other indexes refer to the name by its id */
+		std::vector<uint32_t> ids;
+		for (std::vector<std::string>::const_iterator canonical = prepared.canonicals.begin(); canonical != prepared.canonicals.end(); ++canonical)
+			ids.push_back(names_.Intern(*canonical));
+
+		AddCanonicalMap(prepared, ids.data());
+		AddStrippedMap(prepared, ids.data());
+		AddNameSpellings(prepared, ids.data());
+	}
+
+	/*
+	 * Adds names the same way as Add does one by one, but prepares
+	 * them on multiple threads. Names are then interned serially, as
+	 * ids depend on order, and each kind of index (canonical map,
+	 * stripped map, spelling indexes) is filled by its own thread;
+	 * as each index gets names in the same order, the result is
+	 * identical to serial loading. Indexes are not sharded, so only
+	 * preparation scales beyond INDEX_KINDS threads
+	 */
+	void AddNames(const std::vector<std::string>& names) {
+		static const size_t min_names_per_thread = 1024;
+		static const size_t INDEX_KINDS = 3;
+
+		size_t threads = load_threads_ != 0 ? load_threads_ : std::thread::hardware_concurrency();
+		threads = std::max((size_t)1, std::min(threads, names.size() / min_names_per_thread));
+
+		std::vector<PreparedName> prepared(names.size());
+		RunParallel(threads, [&](size_t task) {
+			for (size_t i = names.size() * task / threads; i < names.size() * (task + 1) / threads; ++i)
+				PrepareName(names[i], prepared[i]);
+		});
+
+		/* ids depend on order, so names are interned sequentially */
+		std::vector<uint32_t> ids;
+		std::vector<size_t> firstids;
+		firstids.reserve(prepared.size());
+		for (std::vector<PreparedName>::const_iterator name = prepared.begin(); name != prepared.end(); ++name) {
+			firstids.push_back(ids.size());
+			for (std::vector<std::string>::const_iterator canonical = name->canonicals.begin(); canonical != name->canonicals.end(); ++canonical)
+				ids.push_back(names_.Intern(*canonical));
+		}
+
+		/* kinds of indexes are independent */
+		RunParallel(std::min(threads, INDEX_KINDS), [&](size_t task) {
+			for (size_t i = 0; i < prepared.size(); ++i) {
+				if (task == 0)
+					AddNameSpellings(prepared[i], ids.data() + firstids[i]);
+				else if (task == 1)
+					AddCanonicalMap(prepared[i], ids.data() + firstids[i]);
+				else
+					AddStrippedMap(prepared[i], ids.data() + firstids[i]);
+			}
+		}, INDEX_KINDS);
+	}
+
+	/* runs job(0)..job(tasks - 1) on given number of threads,
+	 * rethrowing the first exception thrown by any of them */
+	template<class Job>
+	static void RunParallel(size_t threads, const Job& job, size_t tasks = 0) {
+		if (tasks == 0)
+			tasks = threads;
+
+		std::vector<std::exception_ptr> errors(threads);
+		std::vector<std::thread> workers;
+
+		auto worker = [&](size_t thread) {
+			try {
+				for (size_t task = thread; task < tasks; task += threads)
+					job(task);
+			} catch (...) {
+				errors[thread] = std::current_exception();
+			}
+		};
+
+		for (size_t thread = 1; thread < threads; ++thread)
+			workers.push_back(std::thread(worker, thread));
+		worker(0);
+
+		for (std::vector<std::thread>::iterator thread = workers.begin(); thread != workers.end(); ++thread)
+			thread->join();
+
+		for (std::vector<std::exception_ptr>::const_iterator error = errors.begin(); error != errors.end(); ++error)
+			if (*error)
+				std::rethrow_exception(*error);
+	}
+
+	/* adds spelling key to indexes other than the trie */
+	void IndexSpelling(const icu::UnicodeString& key, uint32_t id) {
+		if (deletion_index_)
+			deletion_index_->Insert(key.getBuffer(), key.length(), id);
+		if (bk_tree_)
+			bk_tree_->Insert(key.getBuffer(), key.length(), id);
+	}
+
+	void AddSpelling(const icu::UnicodeString& key, uint32_t name) {
+		uint32_t id = spell_trie_.Insert(key, spelling_map_.GetSize());
+		if (id == TSpell::NO_PAYLOAD)
+			return;
+
+		if (id == spelling_map_.GetSize())
+			IndexSpelling(key, id);
+
+		spelling_map_.Insert(key.getBuffer(), key.length(), name);
+	}
+
+	/* spelling key with given id, sharing its characters */
+	icu::UnicodeString GetSpellingKey(uint32_t id) const {
+		return icu::UnicodeString(false, spelling_map_.GetKeyData(id), spelling_map_.GetKeyLength(id));
+	}
+
+	/* copies names with given ids out of the pool; returns their count */
+	template<class Ids>
+	int GetNames(const Ids& ids, std::vector<std::string>& names) const {
+		names.reserve(names.size() + ids.size());
+		for (const uint32_t* id = ids.begin(); id != ids.end(); ++id)
+			names.push_back(names_.Get(*id));
+
+		return ids.size();
+	}
+
+	/* passes spelling entry ids found within distance to the appender */
+	template<class Appender>
+	void FindSpelling(const icu::UnicodeString& hash, int distance, Appender& appender) const {
+		switch (engine_) {
+		case ENGINE_AUTOMATON:
+			spell_trie_.FindApproxAutomaton(hash, distance, appender);
+			return;
+		case ENGINE_DELETIONS:
+			if (distance <= deletion_index_->GetMaxDistance()) {
+				deletion_index_->FindApprox(hash.getBuffer(), hash.length(), distance, appender);
+				return;
+			}
+			break;
+		case ENGINE_BKTREE:
+			bk_tree_->FindApprox(hash.getBuffer(), hash.length(), distance, appender);
+			return;
+		default:
+			break;
+		}
+
+		spell_trie_.FindApprox(hash, distance, appender);
+	}
+
+	/* passes single query of a batch to batch appender */
+	template<class Appender>
+	class QueryAppender {
+	private:
+		Appender& appender_;
+		const size_t query_;
+
+	public:
+		QueryAppender(Appender& appender, size_t query) : appender_(appender), query_(query) {
+		}
+
+		template<class Char>
+		bool Append(const Char* string, size_t length, uint32_t id) {
+			return appender_.Append(query_, string, length, id);
+		}
+	};
+
+	/* same as FindSpelling for a batch of hashes; appender gets index
+	 * of the hash along with each entry id. Automaton engine walks the
+	 * trie once for the whole batch; others look hashes up one by one,
+	 * as edit branching trie search is faster than batched automaton */
+	template<class Appender>
+	void FindSpellingBatch(const std::vector<icu::UnicodeString>& hashes, int distance, Appender& appender) const {
+		if (engine_ == ENGINE_AUTOMATON) {
+			spell_trie_.FindApproxBatch(hashes, distance, appender);
+			return;
+		}
+
+		for (size_t query = 0; query < hashes.size(); ++query) {
+			QueryAppender<Appender> single(appender, query);
+			FindSpelling(hashes[query], distance, single);
+		}
+	}
+
+	/* the following are checks on hashes already computed with NameToHashes */
+	int FindCanonicalForms(const std::string& hash, std::vector<std::string>& suggestions) const {
+		return GetNames(canonical_map_.GetValues(hash.data(), hash.length()), suggestions);
+	}
+
+	int FindSpellings(const icu::UnicodeString& hashordered, const icu::UnicodeString& hashunordered, int depth, size_t max_results, std::vector<std::string>& suggestions) const {
+		std::set<std::string> suggestions_unique;
+		SpellingCollector collector(*this, hashordered, hashunordered, depth, max_results, suggestions_unique);
+
+		/* swapped adjacent letters count as a single typo in trie search
+		 * already; distance 1 is always tried though, as е->ё change
+		 * counts as zero depth */
+		for (int i = 0; !collector.HasMatches() && i <= std::max(depth, 1); ++i) {
+			collector.SetRealDepth(i);
+			FindSpelling(hashordered, i, collector);
+			if (!collector.IsFull())
+				FindSpelling(hashunordered, i, collector);
+		}
+
+		suggestions.reserve(suggestions.size() + suggestions_unique.size());
+
+		for (std::set<std::string>::const_iterator i = suggestions_unique.begin(); i != suggestions_unique.end(); ++i)
+			suggestions.push_back(*i);
+
+		return suggestions_unique.size();
+	}
+
+	int FindStrippedStatus(const icu::UnicodeString& hashordered, std::vector<std::string>& matches) const {
+		icu::UnicodeString stripped(hashordered);
+		stripped.findAndReplace(g_yo, g_ye);
+
+		return GetNames(stripped_map_.GetValues(stripped.getBuffer(), stripped.length()), matches);
+	}
+
+protected:
+	/* header of compiled database, followed by TSpell::ImageWriter
+	 * arrays of all indexes */
+	struct CompiledHeader {
+		char magic[8];
+		uint32_t version;
+		uint32_t byteorder;  /* COMPILED_BYTEORDER in native order of writer */
+		uint64_t size;       /* of arrays following the header */
+		uint64_t checksum;   /* of arrays following the header */
+		char locale[32];
+	};
+
+	static const char* CompiledMagic() {
+		return "SMANGLDB";
+	}
+
+	static const uint32_t COMPILED_VERSION = 1;
+	static const uint32_t COMPILED_BYTEORDER = 0x01020304;
+
 protected:
-	typedef std::unordered_set<std::string> NamesSet;
-	typedef std::unordered_multimap<std::string, std::string> NamesMap;
-	typedef std::multimap<icu::UnicodeString, std::string> UnicodeNamesMap; // XXX: no hasher fn for UnicodeString
+	/* names are stored once in names pool; indexes refer to them by id */
+	typedef TSpell::FlatMultiMap<char, uint32_t> NamesMap;
+	typedef TSpell::FlatMultiMap<UChar, uint32_t> UnicodeNamesMap;
+
+	template<class Map>
+	static void GetMapStats(const Map& map, IndexStats& stats) {
+		stats.keys = map.GetSize();
+		stats.values = map.GetValueCount();
+		stats.bytes = map.GetMemoryUsage();
+	}
+
+	/* checks that all values of the map are valid name ids */
+	template<class Map>
+	static bool CheckNameIds(const Map& map, size_t names) {
+		for (uint32_t id = 0; id < map.GetSize(); ++id) {
+			const typename Map::Range values = map.GetValues(id);
+			for (const uint32_t* value = values.begin(); value != values.end(); ++value)
+				if (*value >= names)
+					return false;
+		}
+		return true;
+	}
+
+protected:
+	/* results of checks made by raw name string; suggestions are those
+	 * the check has appended */
+	struct CachedResult {
+		int result;
+		std::vector<std::string> suggestions;
+	};
+
+	typedef TSpell::ShardedCache<CachedResult> ResultCache;
+
+	enum CachedCheckType {
+		CACHED_CANONICAL_FORM,
+		CACHED_SPELLING,
+		CACHED_STRIPPED_STATUS,
+		CACHED_CLASSIFY,
+	};
+
+	/* runs check(suggestions) through result cache, if it's enabled */
+	template<class Check>
+	int CachedCheck(CachedCheckType type, int depth, size_t max_results, const std::string& name, std::vector<std::string>& suggestions, Check check) const {
+		if (!cache_)
+			return check(suggestions);
+
+		/* check parameters are prepended to the name, so key is unique for them */
+		std::string key;
+		key.reserve(sizeof(char) + sizeof(depth) + sizeof(max_results) + name.length());
+		key.push_back(static_cast<char>(type));
+		key.append(reinterpret_cast<const char*>(&depth), sizeof(depth));
+		key.append(reinterpret_cast<const char*>(&max_results), sizeof(max_results));
+		key.append(name);
+
+		CachedResult cached;
+		if (!cache_->Get(key, cached)) {
+			cached.result = check(cached.suggestions);
+			cache_->Put(key, cached);
+		}
+
+		suggestions.insert(suggestions.end(), cached.suggestions.begin(), cached.suggestions.end());
+		return cached.result;
+	}
+
+	/* cached results are invalid once names are added */
+	void InvalidateCache() {
+		if (cache_)
+			cache_->Clear();
+	}
+
+protected:
+	/* appender which checks found spelling entries and collects their names */
+	class SpellingCollector {
+	private:
+		const Private& database_;
+		const icu::UnicodeString& hashordered_;
+		const icu::UnicodeString& hashunordered_;
+		const int depth_;
+		const size_t max_results_;
+
+		std::set<std::string>& suggestions_;
+		std::set<uint32_t> seen_;
+		int realdepth_;
+
+	public:
+		SpellingCollector(const Private& database, const icu::UnicodeString& hashordered, const icu::UnicodeString& hashunordered, int depth, size_t max_results, std::set<std::string>& suggestions)
+			: database_(database), hashordered_(hashordered), hashunordered_(hashunordered), depth_(depth), max_results_(max_results), suggestions_(suggestions), realdepth_(0) {
+		}
+
+		/* distance of the following search */
+		void SetRealDepth(int realdepth) {
+			realdepth_ = realdepth;
+		}
+
+		/* whether any entry was found, even if it was then rejected */
+		bool HasMatches() const {
+			return !seen_.empty();
+		}
+
+		bool IsFull() const {
+			return max_results_ != 0 && suggestions_.size() >= max_results_;
+		}
+
+		template<class Char>
+		bool Append(const Char*, size_t, uint32_t id) {
+			/* same key may be found for both hashes */
+			if (!seen_.insert(id).second)
+				return true;
+
+			const icu::UnicodeString key = database_.GetSpellingKey(id);
+
+			/* skip matches that differ only in numeric parts */
+			int dist = -1;
+			dist = PickDist(dist, GetRealApproxDistance(hashordered_, key, realdepth_));
+			dist = PickDist(dist, GetRealApproxDistance(hashunordered_, key, realdepth_));
+
+			if (dist < 0 || dist > depth_)
+				return true;
+
+			const UnicodeNamesMap::Range names = database_.spelling_map_.GetValues(id);
+			for (const uint32_t* name = names.begin(); name != names.end() && !IsFull(); ++name)
+				suggestions_.insert(database_.names_.Get(*name));
+
+			return !IsFull();
+		}
+	};
+
+	/* dispatches keys found by batch search to collectors of the
+	 * names queries belong to */
+	class SpellingBatchCollector {
+	private:
+		std::vector<SpellingCollector*>& collectors_;
+		const std::vector<size_t>& owners_;
+
+	public:
+		SpellingBatchCollector(std::vector<SpellingCollector*>& collectors, const std::vector<size_t>& owners) : collectors_(collectors), owners_(owners) {
+		}
+
+		template<class Char>
+		bool Append(size_t query, const Char* string, size_t length, uint32_t id) {
+			return collectors_[owners_[query]]->Append(string, length, id);
+		}
+	};
 
 protected:
 	const Locale& locale_;
-	NamesSet names_;
+	const SpellingEngine engine_;
+	unsigned int load_threads_;
+
+	TSpell::StringPool names_;
 	NamesMap canonical_map_;
-	UnicodeNamesMap spelling_map_;
 	UnicodeNamesMap stripped_map_;
 
+	/* spelling trie stores id of the key in spelling map as payload */
 	TSpell::UnicodeTrie spell_trie_;
+	UnicodeNamesMap spelling_map_;
+
+	/* compiled database the indexes refer to, if loaded */
+	std::unique_ptr<TSpell::MappedFile> image_;
+
+	/* only for ENGINE_DELETIONS */
+	std::unique_ptr<TSpell::DeletionIndex<UChar> > deletion_index_;
+
+	/* only for ENGINE_BKTREE */
+	std::unique_ptr<TSpell::BKTree<UChar> > bk_tree_;
+
+	/* only if enabled with SetCacheSize */
+	std::unique_ptr<ResultCache> cache_;
 };
 
-Database::Database(const Locale& locale) : private_(new Database::Private(locale)) {
+Database::Database(const Locale& locale, SpellingEngine engine, int index_depth) : private_(new Database::Private(locale, engine, index_depth)) {
 }
 
 Database::~Database() {
@@ -228,159 +696,331 @@ const StreetMangler::Locale& StreetMangler::Database::GetLocale() const {
 }
 
 void Database::Load(const std::string& filename) {
-	DatabaseLoader loader(filename, *this);
+	std::vector<std::string> names;
+	DatabaseLoader loader(filename, names);
 	loader.Parse();
+
+	private_->AddNames(names);
+	private_->InvalidateCache();
+
+	/* pack name maps and spelling index now so first lookup doesn't pay for it */
+	private_->canonical_map_.Freeze();
+	private_->stripped_map_.Freeze();
+	private_->spelling_map_.Freeze();
+	private_->spell_trie_.Freeze();
+	if (private_->deletion_index_)
+		private_->deletion_index_->Freeze();
+}
+
+void Database::LoadCompiled(const std::string& filename) {
+	if (private_->names_.GetSize() != 0)
+		throw std::runtime_error("Compiled database may only be loaded into empty database");
+
+	std::unique_ptr<TSpell::MappedFile> image(new TSpell::MappedFile(filename));
+
+	/* the image is used in place, so all checks are done before any index is touched */
+	Private::CompiledHeader header;
+	if (image->GetSize() < sizeof(header))
+		throw std::runtime_error("Bad compiled database: truncated header");
+
+	memcpy(&header, image->GetData(), sizeof(header));
+	const char* data = static_cast<const char*>(image->GetData()) + sizeof(header);
+
+	if (!std::equal(header.magic, header.magic + sizeof(header.magic), Private::CompiledMagic()))
+		throw std::runtime_error("Bad compiled database: not a compiled database");
+	if (header.version != Private::COMPILED_VERSION || header.byteorder != Private::COMPILED_BYTEORDER)
+		throw std::runtime_error("Bad compiled database: incompatible version or byte order");
+	if (header.size != image->GetSize() - sizeof(header) || header.checksum != TSpell::ImageChecksum(data, header.size))
+		throw std::runtime_error("Bad compiled database: damaged data");
+	if (private_->locale_.GetName().compare(0, sizeof(header.locale), header.locale, strnlen(header.locale, sizeof(header.locale))) != 0)
+		throw std::runtime_error("Bad compiled database: compiled for different locale");
+
+	TSpell::ImageReader reader(data, header.size);
+
+	TSpell::StringPool names;
+	Private::NamesMap canonical_map;
+	Private::UnicodeNamesMap stripped_map;
+	Private::UnicodeNamesMap spelling_map;
+	const char* trie;
+	size_t trie_size;
+
+	if (!names.MapImage(reader) || !canonical_map.MapImage(reader) || !stripped_map.MapImage(reader) ||
+			!spelling_map.MapImage(reader) || !reader.Read(trie, trie_size) || !reader.IsAtEnd())
+		throw std::runtime_error("Bad compiled database: malformed data");
+
+	/* ids are used for lookups unchecked, so all of them must be in range */
+	if (!Private::CheckNameIds(canonical_map, names.GetSize()) || !Private::CheckNameIds(stripped_map, names.GetSize()) ||
+			!Private::CheckNameIds(spelling_map, names.GetSize()) ||
+			!private_->spell_trie_.MapImage(trie, trie_size, spelling_map.GetSize()))
+		throw std::runtime_error("Bad compiled database: malformed data");
+
+	private_->names_ = names;
+	private_->canonical_map_ = canonical_map;
+	private_->stripped_map_ = stripped_map;
+	private_->spelling_map_ = spelling_map;
+	private_->image_.swap(image);
+	private_->InvalidateCache();
+
+	/* other spelling indexes are not stored, and are built from keys */
+	if (private_->deletion_index_ || private_->bk_tree_) {
+		for (uint32_t id = 0; id < private_->spelling_map_.GetSize(); ++id)
+			private_->IndexSpelling(private_->GetSpellingKey(id), id);
+
+		if (private_->deletion_index_)
+			private_->deletion_index_->Freeze();
+	}
+}
+
+void Database::WriteCompiled(const std::string& filename) const {
+	TSpell::ImageWriter writer;
+
+	private_->names_.WriteImage(writer);
+	private_->canonical_map_.WriteImage(writer);
+	private_->stripped_map_.WriteImage(writer);
+	private_->spelling_map_.WriteImage(writer);
+
+	std::ostringstream trie;
+	private_->spell_trie_.WriteImage(trie);
+	const std::string& trie_image = trie.str();
+	writer.Write(trie_image.data(), trie_image.length());
+
+	Private::CompiledHeader header = Private::CompiledHeader();
+	std::copy(Private::CompiledMagic(), Private::CompiledMagic() + sizeof(header.magic), header.magic);
+	header.version = Private::COMPILED_VERSION;
+	header.byteorder = Private::COMPILED_BYTEORDER;
+	header.size = writer.GetData().length();
+	header.checksum = TSpell::ImageChecksum(writer.GetData().data(), writer.GetData().length());
+	private_->locale_.GetName().copy(header.locale, sizeof(header.locale) - 1);
+
+	std::ofstream out(filename.c_str(), std::ios::binary | std::ios::trunc);
+	out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	out.write(writer.GetData().data(), writer.GetData().length());
+	out.close();
+
+	if (!out)
+		throw std::runtime_error(std::string("Cannot write: ") + filename);
 }
 
 void Database::Add(const std::string& name) {
-	Name tokenized(name, private_->locale_);
+	Private::PreparedName prepared;
+	private_->PrepareName(name, prepared);
+	private_->AddPreparedName(prepared);
+	private_->InvalidateCache();
+}
 
-	std::string hash;
-	icu::UnicodeString uhash;
-	icu::UnicodeString uhashordered;
-	icu::UnicodeString uhashunordered;
-
-	private_->NameToHashes(tokenized, &hash, &uhash, &uhashordered, &uhashunordered);
-
-	/* for the locales in which canonical form != full form,
-	 * we need to use canonical form as a reference
-	 *
-	 * XXX: this has a side effect of ignoring special writing
-	 * of status part from the database (e.g. "Русская Слобода" is
-	 * converted to "Русская слобода"). May handle canonical form ==
-	 * full form case specially just using variant from the database */
-	std::set<std::string> canonical_part_variants;
-
-	/* default canonical variant */
-	if (tokenized.GetStatusFlags() & Locale::STATUS_AT_LEFT)
-		canonical_part_variants.insert(tokenized.Join(Name::CANONICALIZE_STATUS|Name::STATUS_TO_LEFT));
-	else if (tokenized.GetStatusFlags() & Locale::STATUS_AT_RIGHT)
-		canonical_part_variants.insert(tokenized.Join(Name::CANONICALIZE_STATUS|Name::STATUS_TO_RIGHT));
+void Database::SetLoadThreads(unsigned int threads) {
+	private_->load_threads_ = threads;
+}
+
+void Database::SetCacheSize(size_t entries) {
+	if (entries == 0)
+		private_->cache_.reset();
 	else
-		canonical_part_variants.insert(tokenized.Join(Name::CANONICALIZE_STATUS));
+		private_->cache_.reset(new Private::ResultCache(entries));
+}
 
-	/* additional canonical variants, which may be enabled depending on flags */
-	if (tokenized.IsStatusPartAtLeft() && (tokenized.GetStatusFlags() & Locale::ORDER_RANDOM_IF_LEFT))
-		canonical_part_variants.insert(tokenized.Join(Name::CANONICALIZE_STATUS|Name::STATUS_TO_RIGHT));
+Database::CacheStats Database::GetCacheStats() const {
+	CacheStats stats = CacheStats();
+	if (private_->cache_) {
+		Private::ResultCache::Stats cachestats = private_->cache_->GetStats();
+		stats.hits = cachestats.hits;
+		stats.misses = cachestats.misses;
+		stats.entries = cachestats.size;
+	}
+	return stats;
+}
 
-	if (tokenized.IsStatusPartAtRight() && (tokenized.GetStatusFlags() & Locale::ORDER_RANDOM_IF_RIGHT))
-		canonical_part_variants.insert(tokenized.Join(Name::CANONICALIZE_STATUS|Name::STATUS_TO_LEFT));
+Database::Stats Database::GetStats() const {
+	Stats stats = Stats();
 
-	/* for each canonical form, fill structures required to link other forms to it */
-	for (std::set<std::string>::iterator canonical = canonical_part_variants.begin(); canonical != canonical_part_variants.end(); ++canonical) {
-		/* for exact match */
-		private_->names_.insert(*canonical);
+	stats.names.keys = stats.names.values = private_->names_.GetSize();
+	stats.names.bytes = private_->names_.GetMemoryUsage();
 
-		/* for canonical form */
-		private_->canonical_map_.insert(std::make_pair(hash, *canonical));
+	Private::GetMapStats(private_->canonical_map_, stats.canonical_map);
+	Private::GetMapStats(private_->stripped_map_, stats.stripped_map);
+	Private::GetMapStats(private_->spelling_map_, stats.spelling_map);
 
-		/* for spelling */
-		private_->spell_trie_.Insert(uhashordered);
-		private_->spelling_map_.insert(std::make_pair(uhashordered, *canonical));
-		if (uhashunordered != uhashordered) {
-			private_->spell_trie_.Insert(uhashunordered);
-			private_->spelling_map_.insert(std::make_pair(uhashunordered, *canonical));
-		}
+	stats.spell_trie.nodes = private_->spell_trie_.GetNodeCount();
+	stats.spell_trie.labels = private_->spell_trie_.GetLabelCount();
+	stats.spell_trie.bytes = private_->spell_trie_.GetMemoryUsage();
+	private_->spell_trie_.GetShape(stats.spell_trie.fanout, stats.spell_trie.depth);
 
-		/* for stripped status */
-		icu::UnicodeString stripped_uhashordered;
-		private_->NameToHashes(tokenized, nullptr, nullptr, &stripped_uhashordered, nullptr, Name::REMOVE_ALL_STATUSES);
-		stripped_uhashordered.findAndReplace(g_yo, g_ye);
-		if (stripped_uhashordered != uhashordered)
-			private_->stripped_map_.insert(std::make_pair(stripped_uhashordered, *canonical));
+	if (private_->deletion_index_) {
+		stats.deletion_index.keys = private_->deletion_index_->GetSize();
+		stats.deletion_index.values = private_->deletion_index_->GetEntryCount();
+		stats.deletion_index.buckets = private_->deletion_index_->GetBucketCount();
+		stats.deletion_index.bytes = private_->deletion_index_->GetMemoryUsage();
+	}
+
+	if (private_->bk_tree_) {
+		stats.bk_tree.keys = stats.bk_tree.values = private_->bk_tree_->GetSize();
+		stats.bk_tree.bytes = private_->bk_tree_->GetMemoryUsage();
 	}
+
+	stats.image_bytes = private_->image_ ? private_->image_->GetSize() : 0;
+	stats.cache = GetCacheStats();
+
+	return stats;
 }
 
 /*
  * Checks
  */
 int Database::CheckExactMatch(const Name& name) const {
-	return private_->names_.find(name.Join()) != private_->names_.end();
+	return private_->names_.Find(name.Join()) != TSpell::StringPool::NOT_FOUND;
 }
 
 int Database::CheckCanonicalForm(const Name& name, std::vector<std::string>& suggestions) const {
 	std::string hash;
 	private_->NameToHashes(name, &hash, nullptr, nullptr, nullptr);
 
-	int count = 0;
-	std::pair<Private::NamesMap::const_iterator, Private::NamesMap::const_iterator> range =
-		private_->canonical_map_.equal_range(hash);
-
-	for (Private::NamesMap::const_iterator i = range.first; i != range.second; ++i, ++count)
-		suggestions.push_back(i->second);
-
-	return count;
+	return private_->FindCanonicalForms(hash, suggestions);
 }
 
-int Database::CheckSpelling(const Name& name, std::vector<std::string>& suggestions, int depth) const {
+int Database::CheckSpelling(const Name& name, std::vector<std::string>& suggestions, int depth, size_t max_results) const {
 	icu::UnicodeString hashordered, hashunordered;
 	private_->NameToHashes(name, nullptr, nullptr, &hashordered, &hashunordered);
 
-	int realdepth = 0;
-	std::set<icu::UnicodeString> matches;
-	for (int i = 0; matches.empty() && i <= depth + 1; ++i) {
-		private_->spell_trie_.FindApprox(hashordered, i, matches);
-		private_->spell_trie_.FindApprox(hashunordered, i, matches);
-		realdepth = i;
+	return private_->FindSpellings(hashordered, hashunordered, depth, max_results, suggestions);
+}
+
+int Database::CheckSpellingBatch(const std::vector<Name>& names, std::vector<std::vector<std::string> >& suggestions, int depth, size_t max_results) const {
+	std::vector<icu::UnicodeString> hashesordered(names.size()), hashesunordered(names.size());
+	std::vector<std::set<std::string> > suggestions_unique(names.size());
+	std::vector<Private::SpellingCollector> collectors;
+	collectors.reserve(names.size());
+
+	for (size_t n = 0; n < names.size(); ++n) {
+		private_->NameToHashes(names[n], nullptr, nullptr, &hashesordered[n], &hashesunordered[n]);
+		collectors.push_back(Private::SpellingCollector(*private_, hashesordered[n], hashesunordered[n], depth, max_results, suggestions_unique[n]));
 	}
 
-	std::set<std::string> suggestions_unique;
-	for (std::set<icu::UnicodeString>::const_iterator i = matches.begin(); i != matches.end(); ++i) {
-		/* skip matches that differ only in numeric parts */
-		int dist = -1;
-		dist = PickDist(dist, private_->GetRealApproxDistance(hashordered, *i, realdepth));
-		dist = PickDist(dist, private_->GetRealApproxDistance(hashunordered, *i, realdepth));
+	/* owners map queries back to names */
+	typedef std::pair<const icu::UnicodeString*, size_t> Query;
+	std::vector<Query> queries;
+	queries.reserve(names.size() * 2);
+	for (size_t n = 0; n < names.size(); ++n) {
+		queries.push_back(Query(&hashesordered[n], n));
+		if (hashesunordered[n] != hashesordered[n])
+			queries.push_back(Query(&hashesunordered[n], n));
+	}
 
-		if (dist < 0 || dist > depth)
-			continue;
+	std::vector<Private::SpellingCollector*> collector_ptrs(names.size());
+	for (size_t n = 0; n < names.size(); ++n)
+		collector_ptrs[n] = &collectors[n];
+
+	std::vector<icu::UnicodeString> hashes;
+	std::vector<size_t> owners;
+	Private::SpellingBatchCollector batchcollector(collector_ptrs, owners);
+
+	/* same iterative deepening as in CheckSpelling, but each round
+	 * only takes names which got no matches yet */
+	for (int i = 0; i <= std::max(depth, 1); ++i) {
+		hashes.clear();
+		owners.clear();
+		for (std::vector<Query>::const_iterator query = queries.begin(); query != queries.end(); ++query) {
+			if (!collectors[query->second].HasMatches()) {
+				hashes.push_back(*query->first);
+				owners.push_back(query->second);
+			}
+		}
 
-		std::pair<Private::UnicodeNamesMap::const_iterator, Private::UnicodeNamesMap::const_iterator> range =
-			private_->spelling_map_.equal_range(*i);
+		if (hashes.empty())
+			break;
 
-		for (Private::UnicodeNamesMap::const_iterator j = range.first; j != range.second; ++j)
-			suggestions_unique.insert(j->second);
-	}
+		for (size_t n = 0; n < names.size(); ++n)
+			collectors[n].SetRealDepth(i);
 
-	suggestions.reserve(suggestions.size() + suggestions_unique.size());
+		private_->FindSpellingBatch(hashes, i, batchcollector);
+	}
 
-	for (std::set<std::string>::const_iterator i = suggestions_unique.begin(); i != suggestions_unique.end(); ++i)
-		suggestions.push_back(*i);
+	int found = 0;
+	suggestions.resize(names.size());
+	for (size_t n = 0; n < names.size(); ++n) {
+		suggestions[n].insert(suggestions[n].end(), suggestions_unique[n].begin(), suggestions_unique[n].end());
+		if (!suggestions_unique[n].empty())
+			++found;
+	}
 
-	return suggestions_unique.size();
+	return found;
 }
 
 int Database::CheckStrippedStatus(const Name& name, std::vector<std::string>& matches) const {
 	icu::UnicodeString uhashordered;
 	private_->NameToHashes(name, nullptr, nullptr, &uhashordered, nullptr);
-	uhashordered.findAndReplace(g_yo, g_ye);
 
-	int count = 0;
-	std::pair<Private::UnicodeNamesMap::const_iterator, Private::UnicodeNamesMap::const_iterator> range =
-		private_->stripped_map_.equal_range(uhashordered);
+	return private_->FindStrippedStatus(uhashordered, matches);
+}
+
+Database::MatchClass Database::Classify(const Name& name, ClassifyResult& result, int depth) const {
+	result.suggestions.clear();
+
+	/* the same stages as separate checks, but with hashes computed once */
+	if (private_->names_.Find(name.Join()) != TSpell::StringPool::NOT_FOUND)
+		return result.match = EXACT_MATCH;
 
-	for (Private::UnicodeNamesMap::const_iterator i = range.first; i != range.second; ++i, ++count)
-		matches.push_back(i->second);
+	std::string hash;
+	icu::UnicodeString hashordered, hashunordered;
+	private_->NameToHashes(name, &hash, nullptr, &hashordered, &hashunordered);
+
+	if (private_->FindCanonicalForms(hash, result.suggestions))
+		return result.match = CANONICAL_FORM;
 
-	return count;
+	if (private_->FindSpellings(hashordered, hashunordered, depth, 0, result.suggestions))
+		return result.match = SPELLING_FIXED;
+
+	if (private_->FindStrippedStatus(hashordered, result.suggestions))
+		return result.match = STRIPPED_STATUS;
+
+	return result.match = NO_MATCH;
 }
 
 /*
  * std::string shortcuts to Checks
  */
 int Database::CheckExactMatch(const std::string& name) const {
-	return private_->names_.find(name) != private_->names_.end();
+	return private_->names_.Find(name) != TSpell::StringPool::NOT_FOUND;
 }
 
 int Database::CheckCanonicalForm(const std::string& name, std::vector<std::string>& suggestions) const {
-	return CheckCanonicalForm(Name(name, private_->locale_), suggestions);
+	return private_->CachedCheck(Private::CACHED_CANONICAL_FORM, 0, 0, name, suggestions, [&](std::vector<std::string>& out) {
+		return CheckCanonicalForm(Name(name, private_->locale_), out);
+	});
 }
 
-int Database::CheckSpelling(const std::string& name, std::vector<std::string>& suggestions, int depth) const {
-	return CheckSpelling(Name(name, private_->locale_), suggestions, depth);
+int Database::CheckSpelling(const std::string& name, std::vector<std::string>& suggestions, int depth, size_t max_results) const {
+	return private_->CachedCheck(Private::CACHED_SPELLING, depth, max_results, name, suggestions, [&](std::vector<std::string>& out) {
+		return CheckSpelling(Name(name, private_->locale_), out, depth, max_results);
+	});
+}
+
+int Database::CheckSpellingBatch(const std::vector<std::string>& names, std::vector<std::vector<std::string> >& suggestions, int depth, size_t max_results) const {
+	std::vector<Name> tokenized;
+	tokenized.reserve(names.size());
+	for (std::vector<std::string>::const_iterator name = names.begin(); name != names.end(); ++name)
+		tokenized.push_back(Name(*name, private_->locale_));
+	return CheckSpellingBatch(tokenized, suggestions, depth, max_results);
+}
+
+Database::MatchClass Database::Classify(const std::string& name, ClassifyResult& result, int depth) const {
+	result.suggestions.clear();
+
+	/* exact match doesn't need tokenizing */
+	if (private_->names_.Find(name) != TSpell::StringPool::NOT_FOUND)
+		return result.match = EXACT_MATCH;
+
+	return result.match = static_cast<MatchClass>(private_->CachedCheck(Private::CACHED_CLASSIFY, depth, 0, name, result.suggestions, [&](std::vector<std::string>& out) {
+		ClassifyResult classified;
+		MatchClass match = Classify(Name(name, private_->locale_), classified, depth);
+		out.swap(classified.suggestions);
+		return static_cast<int>(match);
+	}));
 }
 
 int Database::CheckStrippedStatus(const std::string& name, std::vector<std::string>& matches) const {
-	return CheckStrippedStatus(Name(name, private_->locale_), matches);
+	return private_->CachedCheck(Private::CACHED_STRIPPED_STATUS, 0, 0, name, matches, [&](std::vector<std::string>& out) {
+		return CheckStrippedStatus(Name(name, private_->locale_), out);
+	});
 }
 
 }
@@ -0,0 +1,102 @@
+/*
+ * Copyright (C) 2011-2016 Dmitry Marakasov
+ *
+ * This file is part of streetmangler.
+ *
+ * streetmangler is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * streetmangler is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with streetmangler.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include <streetmangler/databasehandle.hh>
+
+namespace StreetMangler {
+
+DatabaseHandle::DatabaseHandle(const Locale& locale, Database::SpellingEngine engine, int index_depth)
+	: locale_(locale), engine_(engine), index_depth_(index_depth), reload_threads_(1), cache_size_(0),
+	  snapshot_(new Database(locale, engine, index_depth)) {
+}
+
+DatabaseHandle::~DatabaseHandle() {
+	if (reload_thread_.joinable())
+		reload_thread_.join();
+}
+
+DatabaseHandle::Snapshot DatabaseHandle::Get() const {
+	return std::atomic_load(&snapshot_);
+}
+
+void DatabaseHandle::Publish(const Snapshot& snapshot) {
+	std::atomic_store(&snapshot_, snapshot);
+}
+
+std::shared_ptr<Database> DatabaseHandle::Build(const std::vector<std::string>& filenames) const {
+	std::shared_ptr<Database> database(new Database(locale_, engine_, index_depth_));
+	database->SetLoadThreads(reload_threads_);
+	database->SetCacheSize(cache_size_);
+
+	for (std::vector<std::string>::const_iterator filename = filenames.begin(); filename != filenames.end(); ++filename) {
+		if (filename->length() > 3 && filename->rfind(".db") == filename->length() - 3)
+			database->LoadCompiled(*filename);
+		else
+			database->Load(*filename);
+	}
+
+	return database;
+}
+
+void DatabaseHandle::JoinReload() {
+	if (reload_thread_.joinable())
+		reload_thread_.join();
+
+	reload_error_ = nullptr;
+}
+
+void DatabaseHandle::Reload(const std::vector<std::string>& filenames) {
+	JoinReload();
+
+	Publish(Build(filenames));
+}
+
+void DatabaseHandle::StartReload(const std::vector<std::string>& filenames) {
+	JoinReload();
+
+	reload_thread_ = std::thread([this, filenames]() {
+		try {
+			Publish(Build(filenames));
+		} catch (...) {
+			reload_error_ = std::current_exception();
+		}
+	});
+}
+
+void DatabaseHandle::WaitReload() {
+	if (reload_thread_.joinable())
+		reload_thread_.join();
+
+	if (reload_error_) {
+		std::exception_ptr error = reload_error_;
+		reload_error_ = nullptr;
+		std::rethrow_exception(error);
+	}
+}
+
+void DatabaseHandle::SetReloadThreads(unsigned int threads) {
+	reload_threads_ = threads;
+}
+
+void DatabaseHandle::SetCacheSize(size_t entries) {
+	cache_size_ = entries;
+}
+
+}
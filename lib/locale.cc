@@ -38,7 +38,7 @@ Locale::Registrar::Registrar(const std::string& name, const StatusPartDataList*
 	Locale::locales_ = this;
 }
 
-Locale::Locale(const std::string& name) {
+Locale::Locale(const std::string& name) : name_(name) {
 	/* first, find locale in linked list */
 	const Registrar* locale = nullptr;
 	for (const Registrar* cur = locales_; cur; cur = cur->next_) {
@@ -31,23 +31,108 @@ class Name;
 
 class Database {
 public:
-	Database(const Locale& locale);
+	enum SpellingEngine {
+		// try every possible edit on each trie branch; cost grows
+		// exponentially with spelling distance
+		ENGINE_TRIE,
+
+		// walk Levenshtein automaton for the query against the trie;
+		// makes spelling checks with distance 2 and more affordable
+		ENGINE_AUTOMATON,
+
+		// look query up in precomputed index of all key variants with
+		// up to index_depth characters removed; fastest, but needs a
+		// lot of memory for index_depth > 1. Checks with larger depth
+		// fall back to ENGINE_TRIE
+		ENGINE_DELETIONS,
+
+		// search metric tree (BK-tree) of the keys; slow to build
+		ENGINE_BKTREE,
+	};
+
+	// first of the checks which succeeded for a name, in the order
+	// they are made by Classify
+	enum MatchClass {
+		EXACT_MATCH,
+		CANONICAL_FORM,
+		SPELLING_FIXED,
+		STRIPPED_STATUS,
+		NO_MATCH,
+	};
+
+	struct ClassifyResult {
+		MatchClass match;
+		std::vector<std::string> suggestions;
+	};
+
+	struct CacheStats {
+		size_t hits;
+		size_t misses;
+		size_t entries;
+	};
+
+	// bytes are of memory owned by the index; parts used in place
+	// from compiled database are counted in Stats::image_bytes
+	struct IndexStats {
+		size_t keys;
+		size_t values;
+		size_t bytes;
+	};
+
+	// keys are inserted spelling keys, values are their hashed
+	// variants with characters removed
+	struct DeletionIndexStats : IndexStats {
+		size_t buckets;
+	};
+
+	struct TrieStats {
+		size_t nodes;
+		size_t labels;      // characters in node labels
+		size_t bytes;
+		std::vector<size_t> fanout;  // number of nodes by number of children
+		std::vector<size_t> depth;   // number of nodes by depth in nodes
+	};
+
+	struct Stats {
+		IndexStats names;
+		IndexStats canonical_map;
+		IndexStats stripped_map;
+		IndexStats spelling_map;
+		TrieStats spell_trie;
+		DeletionIndexStats deletion_index;  // only for ENGINE_DELETIONS
+		IndexStats bk_tree;                 // only for ENGINE_BKTREE; values are nodes
+		size_t image_bytes;
+		CacheStats cache;
+	};
+
+public:
+	Database(const Locale& locale, SpellingEngine engine = ENGINE_TRIE, int index_depth = 1);
 	virtual ~Database();
 
 	void Load(const std::string& filename);
+	void LoadCompiled(const std::string& filename);
+	void WriteCompiled(const std::string& filename) const;
+	void SetLoadThreads(unsigned int threads);
+	void SetCacheSize(size_t entries);
+	CacheStats GetCacheStats() const;
+	Stats GetStats() const;
 	void Add(const std::string& name);
 
 	const Locale& GetLocale() const;
 
 	int CheckExactMatch(const std::string& name) const;
 	int CheckCanonicalForm(const std::string& name, std::vector<std::string>& suggestions) const;
-	int CheckSpelling(const std::string& name, std::vector<std::string>& suggestions, int depth = 1) const;
+	int CheckSpelling(const std::string& name, std::vector<std::string>& suggestions, int depth = 1, size_t max_results = 0) const;
+	int CheckSpellingBatch(const std::vector<std::string>& names, std::vector<std::vector<std::string> >& suggestions, int depth = 1, size_t max_results = 0) const;
 	int CheckStrippedStatus(const std::string& name, std::vector<std::string>& matches) const;
+	MatchClass Classify(const std::string& name, ClassifyResult& result, int depth = 1) const;
 
 	int CheckExactMatch(const Name& name) const;
 	int CheckCanonicalForm(const Name& name, std::vector<std::string>& suggestions) const;
-	int CheckSpelling(const Name& name, std::vector<std::string>& suggestions, int depth = 1) const;
+	int CheckSpelling(const Name& name, std::vector<std::string>& suggestions, int depth = 1, size_t max_results = 0) const;
+	int CheckSpellingBatch(const std::vector<Name>& names, std::vector<std::vector<std::string> >& suggestions, int depth = 1, size_t max_results = 0) const;
 	int CheckStrippedStatus(const Name& name, std::vector<std::string>& matches) const;
+	MatchClass Classify(const Name& name, ClassifyResult& result, int depth = 1) const;
 
 private:
 	class Private;
@@ -0,0 +1,106 @@
+/*
+ * Copyright (C) 2011-2013 Dmitry Marakasov
+ *
+ * This file is part of streetmangler.
+ *
+ * streetmangler is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * streetmangler is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with streetmangler.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef STREETMANGLER_DATABASEHANDLE_HH
+#define STREETMANGLER_DATABASEHANDLE_HH
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <thread>
+#include <exception>
+
+#include <streetmangler/database.hh>
+
+namespace StreetMangler {
+
+class Locale;
+
+// Holds current immutable snapshot of the database for long running
+// processes. Readers take the snapshot with Get and keep using it for
+// as long as they need; reload builds a new database aside and then
+// atomically publishes it. A replaced snapshot is freed when its last
+// reader drops it
+class DatabaseHandle {
+public:
+	typedef std::shared_ptr<const Database> Snapshot;
+
+public:
+	DatabaseHandle(const Locale& locale, Database::SpellingEngine engine = Database::ENGINE_TRIE, int index_depth = 1);
+	virtual ~DatabaseHandle();
+
+	// current snapshot; doesn't wait for reload to finish, but may
+	// briefly contend with Publish, as atomic shared_ptr access is
+	// lock based in common implementations. Empty database until
+	// first reload or publish
+	Snapshot Get() const;
+
+	void Publish(const Snapshot& snapshot);
+
+	// builds new snapshot from given files (compiled if named *.db)
+	// and publishes it. Throws if any file fails to load, keeping
+	// current snapshot
+	void Reload(const std::vector<std::string>& filenames);
+
+	// same as Reload, but in background thread. Previous background
+	// reload, if any, is waited for first; its error, if not yet
+	// reported by WaitReload, is dropped. Reloads are to be started
+	// from single thread, while Get may be called from any
+	void StartReload(const std::vector<std::string>& filenames);
+
+	// waits for background reload; rethrows its error. Errors are
+	// only reported here: Reload and StartReload drop error of a
+	// previous background reload, as the new one supersedes it
+	void WaitReload();
+
+	// threads to parse names with on reload (default 1, so reload
+	// doesn't take CPU from queries; 0 means all cores)
+	void SetReloadThreads(unsigned int threads);
+
+	// result cache size for snapshots built by subsequent reloads,
+	// see Database::SetCacheSize
+	void SetCacheSize(size_t entries);
+
+private:
+	DatabaseHandle(const DatabaseHandle&);
+	DatabaseHandle& operator=(const DatabaseHandle&);
+
+	std::shared_ptr<Database> Build(const std::vector<std::string>& filenames) const;
+
+	/* waits for background reload and drops its error */
+	void JoinReload();
+
+private:
+	const Locale& locale_;
+	const Database::SpellingEngine engine_;
+	const int index_depth_;
+
+	unsigned int reload_threads_;
+	size_t cache_size_;
+
+	Snapshot snapshot_;  /* only accessed with std::atomic_* */
+
+	std::thread reload_thread_;
+	std::exception_ptr reload_error_;
+};
+
+}
+
+#endif
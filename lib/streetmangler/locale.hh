@@ -145,12 +145,15 @@ private:
 	typedef std::vector<StatusPart> StatusPartVector;
 	typedef std::map<std::string, const StatusPart*> StatusPartMap;
 
+	std::string name_;
 	StatusPartVector status_parts_;
 	StatusPartMap status_part_by_any_;
 
 public:
 	Locale(const std::string& name);
 
+	const std::string& GetName() const { return name_; }
+
 	const StatusPart* FindStatus(const std::string& name) const;
 };
 
@@ -81,9 +81,9 @@ public:
 		return v;
 	}
 
-	std::vector<std::string> CheckSpelling(const std::string &name, int depth = 1) {
+	std::vector<std::string> CheckSpelling(const std::string &name, int depth = 1, size_t max_results = 0) {
 		std::vector<std::string> v;
-		self->CheckSpelling(name, v, depth);
+		self->CheckSpelling(name, v, depth, max_results);
 		return v;
 	}
 
@@ -99,9 +99,9 @@ public:
 		return v;
 	}
 
-	std::vector<std::string> CheckSpelling(Name &name, int depth = 1) {
+	std::vector<std::string> CheckSpelling(Name &name, int depth = 1, size_t max_results = 0) {
 		std::vector<std::string> v;
-		self->CheckSpelling(name, v, depth);
+		self->CheckSpelling(name, v, depth, max_results);
 		return v;
 	}
 
@@ -0,0 +1,155 @@
+/*
+ * Copyright (C) 2011-2016 Dmitry Marakasov
+ *
+ * This file is part of streetmangler.
+ *
+ * streetmangler is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * streetmangler is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with streetmangler.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include <string>
+#include <vector>
+#include <thread>
+
+#include <streetmangler/database.hh>
+#include <streetmangler/locale.hh>
+#include "database_testing.hh"
+
+BEGIN_TEST()
+	using StreetMangler::Database;
+	using StreetMangler::Locale;
+
+	/* assumes working locale, see locale_test */
+	Locale locale("ru_RU");
+
+	static const char* queries[] = {
+		"улица Ленина", "ленина улица", "Лененаулица", "Ленина", "Зеленая улица", "проспект Мира", "Мира",
+	};
+	static const size_t nqueries = sizeof(queries) / sizeof(queries[0]);
+
+	Database reference(locale);
+	reference.Add("улица Ленина");
+	reference.Add("Зелёная улица");
+
+	Database db(locale);
+	db.Add("улица Ленина");
+	db.Add("Зелёная улица");
+
+	/* disabled by default */
+	{
+		std::vector<std::string> suggestions;
+		db.CheckSpelling("Лененаулица", suggestions);
+		EXPECT_TRUE(db.GetCacheStats().hits == 0 && db.GetCacheStats().misses == 0);
+	}
+
+	db.SetCacheSize(64);
+
+	/* cached results are the same as uncached, both for the first
+	 * and for repeated checks */
+	for (int pass = 0; pass < 2; ++pass) {
+		for (size_t i = 0; i < nqueries; ++i) {
+			std::vector<std::string> uncached, cached;
+			int count = reference.CheckCanonicalForm(queries[i], uncached);
+			EXPECT_INT(db.CheckCanonicalForm(queries[i], cached), count);
+			EXPECT_TRUE(cached == uncached);
+
+			uncached.clear();
+			cached.clear();
+			count = reference.CheckSpelling(queries[i], uncached, 2);
+			EXPECT_INT(db.CheckSpelling(queries[i], cached, 2), count);
+			EXPECT_TRUE(cached == uncached);
+
+			uncached.clear();
+			cached.clear();
+			count = reference.CheckStrippedStatus(queries[i], uncached);
+			EXPECT_INT(db.CheckStrippedStatus(queries[i], cached), count);
+			EXPECT_TRUE(cached == uncached);
+
+			Database::ClassifyResult uncached_class, cached_class;
+			Database::MatchClass match = reference.Classify(queries[i], uncached_class);
+			EXPECT_INT(db.Classify(queries[i], cached_class), match);
+			EXPECT_TRUE(cached_class.suggestions == uncached_class.suggestions);
+		}
+	}
+
+	/* exact matches in Classify bypass the cache */
+	EXPECT_TRUE(db.GetCacheStats().misses == nqueries * 4 - 1);
+	EXPECT_TRUE(db.GetCacheStats().hits == nqueries * 4 - 1);
+
+	/* suggestions are appended, as without cache */
+	{
+		std::vector<std::string> suggestions(1, "first");
+		EXPECT_INT(db.CheckCanonicalForm("ленина улица", suggestions), 1);
+		EXPECT_INT(suggestions.size(), 2);
+		EXPECT_STRING(suggestions[0], "first");
+		EXPECT_STRING(suggestions[1], "улица Ленина");
+	}
+
+	/* depth is a part of the key */
+	{
+		std::vector<std::string> suggestions;
+		EXPECT_INT(db.CheckSpelling("улица Лененаа", suggestions, 1), 0);
+		EXPECT_INT(db.CheckSpelling("улица Лененаа", suggestions, 2), 1);
+	}
+
+	/* added names invalidate cached results */
+	{
+		std::vector<std::string> suggestions;
+		EXPECT_INT(db.CheckCanonicalForm("мира проспект", suggestions), 0);
+		db.Add("проспект Мира");
+		reference.Add("проспект Мира");
+		EXPECT_TRUE(db.GetCacheStats().entries == 0);
+		EXPECT_INT(db.CheckCanonicalForm("мира проспект", suggestions), 1);
+	}
+
+	/* cache is bounded */
+	{
+		db.SetCacheSize(32);
+		std::vector<std::string> suggestions;
+		for (int i = 0; i < 1000; ++i)
+			db.CheckCanonicalForm("улица " + std::to_string(i), suggestions);
+		EXPECT_TRUE(db.GetCacheStats().entries <= 32);
+		EXPECT_TRUE(db.GetCacheStats().entries > 0);
+	}
+
+	/* concurrent checks with eviction going on give the same results */
+	{
+		db.SetCacheSize(4);
+
+		std::vector<std::vector<std::string> > uncached(nqueries);
+		for (size_t i = 0; i < nqueries; ++i)
+			reference.CheckSpelling(queries[i], uncached[i], 2);
+
+		std::vector<int> mismatches(4);
+		std::vector<std::thread> threads;
+		for (size_t t = 0; t < mismatches.size(); ++t) {
+			threads.push_back(std::thread([&, t]() {
+				for (int round = 0; round < 200; ++round) {
+					for (size_t i = 0; i < nqueries; ++i) {
+						std::vector<std::string> suggestions;
+						db.CheckSpelling(queries[i], suggestions, 2);
+						if (suggestions != uncached[i])
+							++mismatches[t];
+					}
+				}
+			}));
+		}
+		for (size_t t = 0; t < threads.size(); ++t)
+			threads[t].join();
+
+		for (size_t t = 0; t < mismatches.size(); ++t)
+			EXPECT_INT(mismatches[t], 0);
+		EXPECT_TRUE(db.GetCacheStats().hits + db.GetCacheStats().misses == mismatches.size() * 200 * nqueries);
+	}
+END_TEST()
@@ -68,4 +68,25 @@ BEGIN_TEST()
 	CHECK_STRIPPED_STATUS(db, "Зелёная");
 	CHECK_NO_STRIPPED_STATUS(db, "Красная");
 
+	/* Classify stops at the first check which succeeds */
+	{
+		Database::ClassifyResult classified;
+
+		EXPECT_INT(db.Classify("просп. Ленина", classified), Database::EXACT_MATCH);
+		EXPECT_TRUE(classified.suggestions.empty());
+
+		EXPECT_INT(db.Classify("пр. Ленина", classified), Database::CANONICAL_FORM);
+		EXPECT_TRUE(classified.suggestions == std::vector<std::string>(1, "просп. Ленина"));
+
+		EXPECT_INT(db.Classify("Зеленая улица", classified), Database::SPELLING_FIXED);
+		EXPECT_TRUE(classified.suggestions == std::vector<std::string>(1, "Зелёная ул."));
+
+		EXPECT_INT(db.Classify("Зелёная", classified), Database::STRIPPED_STATUS);
+		EXPECT_TRUE(classified.suggestions == std::vector<std::string>(1, "Зелёная ул."));
+
+		EXPECT_INT(db.Classify("Красная улица", classified), Database::NO_MATCH);
+		EXPECT_TRUE(classified.suggestions.empty());
+		EXPECT_INT(classified.match, Database::NO_MATCH);
+	}
+
 END_TEST()
@@ -0,0 +1,232 @@
+/*
+ * Copyright (C) 2011-2016 Dmitry Marakasov
+ *
+ * This file is part of streetmangler.
+ *
+ * streetmangler is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * streetmangler is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with streetmangler.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <fstream>
+#include <string>
+#include <vector>
+#include <stdexcept>
+
+#include <string.h>
+#include <unistd.h>
+#include <stdlib.h>
+
+#include <tspell/image.hh>
+
+#include <streetmangler/database.hh>
+#include <streetmangler/locale.hh>
+#include "database_testing.hh"
+
+BEGIN_TEST()
+	using StreetMangler::Database;
+	using StreetMangler::Locale;
+
+	/* assumes working locale, see locale_test */
+	Locale locale("ru_RU");
+
+	char filename[] = "/tmp/compiled_test.XXXXXX";
+	int fd = mkstemp(filename);
+	EXPECT_TRUE(fd != -1);
+	close(fd);
+
+	Database::Stats source_stats;
+
+	{
+		Database db(locale);
+
+		db.Add("улица Ленина");
+		db.Add("Зелёная улица");
+		db.Add("улица Льва Толстого");
+		db.Add("1-я улица Строителей");
+
+		db.WriteCompiled(filename);
+
+		source_stats = db.GetStats();
+		EXPECT_EQUAL(size_t, source_stats.names.keys, 4);
+		EXPECT_EQUAL(size_t, source_stats.canonical_map.keys, 4);
+		EXPECT_EQUAL(size_t, source_stats.image_bytes, 0);
+		EXPECT_TRUE(source_stats.names.bytes > 0 && source_stats.spelling_map.bytes > 0 && source_stats.spell_trie.bytes > 0);
+
+		/* every node is counted once in each histogram */
+		size_t fanout_nodes = 0, depth_nodes = 0, children = 0;
+		for (size_t i = 0; i < source_stats.spell_trie.fanout.size(); ++i) {
+			fanout_nodes += source_stats.spell_trie.fanout[i];
+			children += i * source_stats.spell_trie.fanout[i];
+		}
+		for (size_t i = 0; i < source_stats.spell_trie.depth.size(); ++i)
+			depth_nodes += source_stats.spell_trie.depth[i];
+		EXPECT_EQUAL(size_t, fanout_nodes, source_stats.spell_trie.nodes);
+		EXPECT_EQUAL(size_t, depth_nodes, source_stats.spell_trie.nodes);
+		EXPECT_EQUAL(size_t, children + 1, source_stats.spell_trie.nodes);
+		EXPECT_EQUAL(size_t, source_stats.spell_trie.depth[0], 1);
+	}
+
+	{
+		/* compiled database is used in place, so indexes own no memory */
+		Database db(locale);
+		db.LoadCompiled(filename);
+
+		Database::Stats stats = db.GetStats();
+		EXPECT_TRUE(stats.image_bytes > 0);
+		EXPECT_EQUAL(size_t, stats.names.keys, source_stats.names.keys);
+		EXPECT_EQUAL(size_t, stats.spelling_map.values, source_stats.spelling_map.values);
+		EXPECT_EQUAL(size_t, stats.spell_trie.nodes, source_stats.spell_trie.nodes);
+		EXPECT_TRUE(stats.spell_trie.fanout == source_stats.spell_trie.fanout);
+		EXPECT_EQUAL(size_t, stats.names.bytes + stats.canonical_map.bytes + stats.stripped_map.bytes + stats.spelling_map.bytes + stats.spell_trie.bytes, 0);
+
+		/* indexes of other engines are not built */
+		EXPECT_EQUAL(size_t, stats.deletion_index.keys + stats.deletion_index.values + stats.deletion_index.buckets + stats.deletion_index.bytes, 0);
+		EXPECT_EQUAL(size_t, stats.bk_tree.keys + stats.bk_tree.values + stats.bk_tree.bytes, 0);
+	}
+
+	/* all spelling engines should work with compiled database */
+	static const Database::SpellingEngine engines[] = {
+		Database::ENGINE_TRIE,
+		Database::ENGINE_AUTOMATON,
+		Database::ENGINE_DELETIONS,
+		Database::ENGINE_BKTREE,
+	};
+
+	for (const Database::SpellingEngine* engine = engines; engine != engines + sizeof(engines)/sizeof(engines[0]); ++engine) {
+		std::cerr << "Engine " << *engine << std::endl;
+
+		Database db(locale, *engine);
+		EXPECT_NO_EXCEPTION(db.LoadCompiled(filename));
+
+		/* indexes built from keys on load are owned and reported */
+		{
+			Database::Stats stats = db.GetStats();
+			if (*engine == Database::ENGINE_DELETIONS) {
+				EXPECT_EQUAL(size_t, stats.deletion_index.keys, source_stats.spelling_map.keys);
+				EXPECT_TRUE(stats.deletion_index.values > stats.deletion_index.keys);
+				EXPECT_TRUE(stats.deletion_index.buckets > 0 && stats.deletion_index.bytes > 0);
+			} else {
+				EXPECT_EQUAL(size_t, stats.deletion_index.keys + stats.deletion_index.bytes, 0);
+			}
+			if (*engine == Database::ENGINE_BKTREE) {
+				EXPECT_EQUAL(size_t, stats.bk_tree.keys, source_stats.spelling_map.keys);
+				EXPECT_TRUE(stats.bk_tree.bytes > 0);
+			} else {
+				EXPECT_EQUAL(size_t, stats.bk_tree.keys + stats.bk_tree.bytes, 0);
+			}
+		}
+
+		CHECK_EXACT_MATCH(db, "улица Ленина");
+		CHECK_NO_EXACT_MATCH(db, "улица Ленена");
+		CHECK_CANONICAL_FORM(db, "ул Ленина", "улица Ленина");
+		CHECK_SPELLING(db, "улица Ленена", "улица Ленина", 1);
+		CHECK_SPELLING(db, "Зеленая улица", "Зелёная улица", 0);
+		CHECK_SPELLING(db, "Толстого Льва улица", "улица Льва Толстого", 1);
+		CHECK_NO_SPELLING(db, "2-я улица Строителей", 2);
+		CHECK_STRIPPED_STATUS(db, "Ленина");
+		CHECK_NO_STRIPPED_STATUS(db, "Красная");
+
+		/* adding to compiled database should work too */
+		db.Add("улица Горького");
+		CHECK_EXACT_MATCH(db, "улица Горького");
+		CHECK_SPELLING(db, "улица Горкого", "улица Горького", 1);
+		CHECK_SPELLING(db, "улица Ленена", "улица Ленина", 1);
+		CHECK_STRIPPED_STATUS(db, "Горького");
+
+		/* compiled database is only loaded into empty one */
+		EXPECT_EXCEPTION(db.LoadCompiled(filename), std::runtime_error);
+	}
+
+	{
+		/* damaged database */
+		std::string image;
+		{
+			std::ifstream in(filename, std::ios::binary);
+			image.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+		}
+
+		image[image.length() / 2] ^= 1;
+		{
+			std::ofstream out(filename, std::ios::binary | std::ios::trunc);
+			out.write(image.data(), image.length());
+		}
+
+		Database db(locale);
+		EXPECT_EXCEPTION(db.LoadCompiled(filename), std::runtime_error);
+		CHECK_NO_EXACT_MATCH(db, "улица Ленина");
+	}
+
+	{
+		/* out of range name id with valid checksum */
+		{
+			Database db(locale);
+			db.Add("улица Ленина");
+			db.WriteCompiled(filename);
+		}
+
+		std::string image;
+		{
+			std::ifstream in(filename, std::ios::binary);
+			image.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+		}
+
+		/* arrays follow 64 byte header, each prefixed with element
+		 * count and size and padded to 8 bytes; values of canonical
+		 * map come after 3 arrays of names pool and 3 of map keys */
+		static const size_t header_size = 64, checksum_offset = 24;
+		size_t offset = header_size;
+		for (int array = 0; array < 7; ++array) {
+			uint64_t counts[2];
+			memcpy(counts, image.data() + offset, sizeof(counts));
+			offset += sizeof(counts) + (counts[0] * counts[1] + 7) / 8 * 8;
+		}
+
+		uint64_t counts[2];
+		memcpy(counts, image.data() + offset, sizeof(counts));
+		EXPECT_EQUAL(uint64_t, counts[0], 1);
+		EXPECT_EQUAL(uint64_t, counts[1], sizeof(uint32_t));
+
+		const uint32_t bad_id = 1000;
+		memcpy(&image[offset + sizeof(counts)], &bad_id, sizeof(bad_id));
+
+		const uint64_t checksum = TSpell::ImageChecksum(image.data() + header_size, image.length() - header_size);
+		memcpy(&image[checksum_offset], &checksum, sizeof(checksum));
+
+		{
+			std::ofstream out(filename, std::ios::binary | std::ios::trunc);
+			out.write(image.data(), image.length());
+		}
+
+		Database db(locale);
+		EXPECT_EXCEPTION(db.LoadCompiled(filename), std::runtime_error);
+		CHECK_NO_EXACT_MATCH(db, "улица Ленина");
+	}
+
+	{
+		/* locale mismatch */
+		Locale uk_locale("uk_UA");
+		Database uk_db(uk_locale);
+		uk_db.Add("вулиця Шевченка");
+		uk_db.WriteCompiled(filename);
+
+		Database db(locale);
+		EXPECT_EXCEPTION(db.LoadCompiled(filename), std::runtime_error);
+	}
+
+	unlink(filename);
+
+	{
+		Database db(locale);
+		EXPECT_EXCEPTION(db.LoadCompiled("/nonexistent"), std::runtime_error);
+	}
+END_TEST()
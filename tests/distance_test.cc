@@ -0,0 +1,203 @@
+/*
+ * Copyright (C) 2011-2016 Dmitry Marakasov
+ *
+ * This file is part of streetmangler.
+ *
+ * streetmangler is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * streetmangler is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with streetmangler.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include <algorithm>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <stdlib.h>
+
+#include <tspell/distance.hh>
+#include <tspell/matcher.hh>
+
+#include "testing.hh"
+
+namespace {
+
+/* plain full matrix restricted Damerau-Levenshtein distance */
+int RestrictedReference(const std::string& a, const std::string& b) {
+	std::vector<std::vector<int> > d(a.length() + 1, std::vector<int>(b.length() + 1));
+	for (size_t i = 0; i <= a.length(); ++i)
+		d[i][0] = i;
+	for (size_t j = 0; j <= b.length(); ++j)
+		d[0][j] = j;
+
+	for (size_t i = 1; i <= a.length(); ++i) {
+		for (size_t j = 1; j <= b.length(); ++j) {
+			d[i][j] = std::min(std::min(d[i - 1][j], d[i][j - 1]) + 1, d[i - 1][j - 1] + (a[i - 1] == b[j - 1] ? 0 : 1));
+			if (i > 1 && j > 1 && a[i - 1] == b[j - 2] && a[i - 2] == b[j - 1])
+				d[i][j] = std::min(d[i][j], d[i - 2][j - 2] + 1);
+		}
+	}
+
+	return d[a.length()][b.length()];
+}
+
+/* plain full matrix unrestricted Damerau-Levenshtein distance (Lowrance-Wagner) */
+int UnrestrictedReference(const std::string& a, const std::string& b) {
+	const int infinity = a.length() + b.length();
+	std::vector<std::vector<int> > d(a.length() + 2, std::vector<int>(b.length() + 2));
+	std::map<char, size_t> lastrow;
+
+	d[0][0] = infinity;
+	for (size_t i = 0; i <= a.length(); ++i) {
+		d[i + 1][0] = infinity;
+		d[i + 1][1] = i;
+	}
+	for (size_t j = 0; j <= b.length(); ++j) {
+		d[0][j + 1] = infinity;
+		d[1][j + 1] = j;
+	}
+
+	for (size_t i = 1; i <= a.length(); ++i) {
+		size_t lastcol = 0;
+		for (size_t j = 1; j <= b.length(); ++j) {
+			const size_t i1 = lastrow[b[j - 1]];
+			const size_t j1 = lastcol;
+			int cost = 1;
+			if (a[i - 1] == b[j - 1]) {
+				cost = 0;
+				lastcol = j;
+			}
+			d[i + 1][j + 1] = std::min(std::min(d[i][j] + cost, d[i + 1][j] + 1), std::min(d[i][j + 1] + 1, d[i1][j1] + (int)(i - i1 - 1) + 1 + (int)(j - j1 - 1)));
+		}
+		lastrow[a[i - 1]] = i;
+	}
+
+	return d[a.length() + 1][b.length() + 1];
+}
+
+int Restricted(const std::string& a, const std::string& b, int bound) {
+	return TSpell::BoundedDistance(a.data(), a.length(), b.data(), b.length(), bound);
+}
+
+int Matched(const std::string& a, const std::string& b, int bound) {
+	return TSpell::DistanceMatcher<char>(a.data(), a.length()).Distance(b.data(), b.length(), bound);
+}
+
+int Unrestricted(const std::string& a, const std::string& b, int bound) {
+	TSpell::DamerauScratch scratch;
+	return TSpell::DamerauDistance(a.data(), a.length(), b.data(), b.length(), bound, scratch);
+}
+
+std::string RandomString(size_t maxlength) {
+	std::string result(rand() % (maxlength + 1), 'a');
+	for (size_t i = 0; i < result.length(); ++i)
+		result[i] = 'a' + rand() % 4;
+	return result;
+}
+
+/* applies a few random edits, so strings are mostly within small distance */
+std::string Misspell(std::string string) {
+	for (int edits = rand() % 4; edits > 0; --edits) {
+		const size_t pos = string.empty() ? 0 : rand() % string.length();
+		switch (string.empty() ? 0 : rand() % 4) {
+		case 0: string.insert(pos, 1, 'a' + rand() % 4); break;
+		case 1: string.erase(pos, 1); break;
+		case 2: string[pos] = 'a' + rand() % 4; break;
+		case 3: if (pos + 1 < string.length()) std::swap(string[pos], string[pos + 1]); break;
+		}
+	}
+	return string;
+}
+
+}
+
+/* checks all kernels against references for all bounds up to 3 */
+#define CHECK_DISTANCES(a, b) { \
+		const int restricted = RestrictedReference(a, b); \
+		const int unrestricted = UnrestrictedReference(a, b); \
+		for (int bound = 0; bound <= 3; ++bound) { \
+			EXPECT_INT(Restricted(a, b, bound), std::min(restricted, bound + 1)); \
+			EXPECT_INT(Matched(a, b, bound), std::min(restricted, bound + 1)); \
+			EXPECT_INT(Unrestricted(a, b, bound), std::min(unrestricted, bound + 1)); \
+		} \
+	}
+
+BEGIN_TEST()
+	/* references themselves */
+	EXPECT_INT(RestrictedReference("ca", "abc"), 3);
+	EXPECT_INT(UnrestrictedReference("ca", "abc"), 2);
+	EXPECT_INT(RestrictedReference("ab", "ba"), 1);
+	EXPECT_INT(UnrestrictedReference("", "abc"), 3);
+
+	/* empty strings on either side */
+	CHECK_DISTANCES("", "");
+	CHECK_DISTANCES("", "a");
+	CHECK_DISTANCES("a", "");
+	CHECK_DISTANCES("", "abcd");
+	CHECK_DISTANCES("abcd", "");
+
+	/* adjacent swaps, and restricted versus unrestricted distance */
+	CHECK_DISTANCES("ab", "ba");
+	CHECK_DISTANCES("abcd", "badc");
+	CHECK_DISTANCES("abcd", "acbd");
+	CHECK_DISTANCES("ca", "abc");
+	CHECK_DISTANCES("abc", "ca");
+	CHECK_DISTANCES("abc", "bca");
+
+	/* early exit at each bound: distances 1..4 against bounds 0..3 */
+	CHECK_DISTANCES("abcdefgh", "abcdefgx");
+	CHECK_DISTANCES("abcdefgh", "xbcdefgx");
+	CHECK_DISTANCES("abcdefgh", "xbcxefgx");
+	CHECK_DISTANCES("abcdefgh", "xbcxexgx");
+	CHECK_DISTANCES("abcdefgh", "abcd");
+	CHECK_DISTANCES("abcdefgh", "hgfedcba");
+
+	/* queries longer than a machine word fall back to BoundedDistance */
+	{
+		const std::string query = "thequickbrownfoxjumpsoverthelazydogthequickbrownfoxjumpsoverthelazydog";
+		EXPECT_TRUE(query.length() > 64);
+
+		std::string swapped = query;
+		std::swap(swapped[40], swapped[41]);
+		std::string changed = swapped;
+		changed[3] = 'x';
+
+		CHECK_DISTANCES(query, query);
+		CHECK_DISTANCES(query, swapped);
+		CHECK_DISTANCES(query, changed);
+		CHECK_DISTANCES(query, query.substr(1));
+		CHECK_DISTANCES(query, query.substr(0, 64));
+		CHECK_DISTANCES(query.substr(0, 64), query.substr(0, 63) + "x");
+	}
+
+	/* random strings over a small alphabet, so matches and swaps are common */
+	{
+		srand(1);
+		int mismatches = 0;
+		for (int n = 0; n < 20000; ++n) {
+			const std::string a = RandomString(n % 10 == 0 ? 80 : 12);
+			const std::string b = rand() % 2 ? Misspell(a) : RandomString(12);
+			const int restricted = RestrictedReference(a, b);
+			const int unrestricted = UnrestrictedReference(a, b);
+			for (int bound = 0; bound <= 3; ++bound) {
+				if (Restricted(a, b, bound) != std::min(restricted, bound + 1) ||
+						Matched(a, b, bound) != std::min(restricted, bound + 1) ||
+						Unrestricted(a, b, bound) != std::min(unrestricted, bound + 1)) {
+					std::cerr << "mismatch for \"" << a << "\", \"" << b << "\", bound " << bound << std::endl;
+					++mismatches;
+				}
+			}
+		}
+		EXPECT_INT(mismatches, 0);
+	}
+END_TEST()
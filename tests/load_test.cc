@@ -0,0 +1,140 @@
+/*
+ * Copyright (C) 2011-2016 Dmitry Marakasov
+ *
+ * This file is part of streetmangler.
+ *
+ * streetmangler is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * streetmangler is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with streetmangler.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+#include <stdlib.h>
+
+#include <streetmangler/database.hh>
+#include <streetmangler/locale.hh>
+#include "database_testing.hh"
+
+/* generates distinct names, enough for loading on multiple threads */
+static std::vector<std::string> GenerateNames(size_t count) {
+	static const char* statuses[] = { "улица", "переулок", "проезд", "Набережная" };
+	static const char* syllables[] = { "ка", "ло", "ми", "ре", "ту", "сы", "на", "во", "зе", "ду", "ри", "ша", "бе", "го", "пу", "ня" };
+
+	std::vector<std::string> names;
+	for (size_t i = 0; i < count; ++i) {
+		std::string name = statuses[i % 4];
+		name += " Т";
+		for (size_t n = i; n > 0; n /= 16)
+			name += syllables[n % 16];
+		names.push_back(name + "ская");
+	}
+	return names;
+}
+
+static std::string ReadFile(const std::string& filename) {
+	std::ifstream in(filename.c_str(), std::ios::binary);
+	std::ostringstream contents;
+	contents << in.rdbuf();
+	return contents.str();
+}
+
+BEGIN_TEST()
+	using StreetMangler::Database;
+	using StreetMangler::Locale;
+
+	/* assumes working locale, see locale_test */
+	Locale locale("ru_RU");
+
+	char dirname[] = "/tmp/load_test.XXXXXX";
+	EXPECT_TRUE(mkdtemp(dirname) != NULL);
+
+	const std::string mainfile = std::string(dirname) + "/main.txt";
+	const std::string includedfile = std::string(dirname) + "/included.txt";
+	const std::string compiledfile = std::string(dirname) + "/compiled.db";
+
+	std::vector<std::string> names = GenerateNames(6000);
+	names.push_back("улица Ленина");
+	names.push_back("Ленина улица"); /* same name again */
+	names.push_back("Зелёная улица");
+
+	/* the first half goes to included file */
+	{
+		std::ofstream main(mainfile.c_str());
+		std::ofstream included(includedfile.c_str());
+		for (size_t i = 0; i < names.size(); ++i) {
+			if (i < names.size() / 2)
+				included << names[i] << std::endl;
+			if (i == names.size() / 2)
+				main << ".include included.txt" << std::endl;
+			if (i >= names.size() / 2)
+				main << names[i] << std::endl;
+		}
+	}
+
+	/* reference is names added one by one */
+	std::string reference;
+	{
+		Database db(locale);
+		for (std::vector<std::string>::const_iterator name = names.begin(); name != names.end(); ++name)
+			db.Add(*name);
+		db.WriteCompiled(compiledfile);
+		reference = ReadFile(compiledfile);
+	}
+
+	/* loading on any number of threads should give identical indexes */
+	static const unsigned int threads[] = { 1, 2, 4, 0 };
+	for (const unsigned int* nthreads = threads; nthreads != threads + sizeof(threads)/sizeof(threads[0]); ++nthreads) {
+		std::cerr << "Threads " << *nthreads << std::endl;
+
+		Database db(locale);
+		db.SetLoadThreads(*nthreads);
+		EXPECT_NO_EXCEPTION(db.Load(mainfile));
+
+		CHECK_EXACT_MATCH(db, names[0]);
+		CHECK_EXACT_MATCH(db, names[names.size() / 2]);
+		CHECK_CANONICAL_FORM_HAS(db, "Ленина ул", "улица Ленина");
+		CHECK_SPELLING(db, "Зеленая улица", "Зелёная улица", 0);
+
+		db.WriteCompiled(compiledfile);
+		EXPECT_TRUE(ReadFile(compiledfile) == reference);
+	}
+
+	{
+		/* names added after load go to frozen indexes as well */
+		Database db(locale);
+		EXPECT_NO_EXCEPTION(db.Load(mainfile));
+		db.Add("улица Горького");
+
+		CHECK_EXACT_MATCH(db, names[0]);
+		CHECK_EXACT_MATCH(db, "улица Горького");
+		CHECK_CANONICAL_FORM_HAS(db, "Ленина ул", "улица Ленина");
+		CHECK_SPELLING(db, "улица Горкого", "улица Горького", 1);
+	}
+
+	{
+		/* missing include is an error */
+		std::ofstream(mainfile.c_str()) << ".include nonexistent.txt" << std::endl;
+
+		Database db(locale);
+		EXPECT_EXCEPTION(db.Load(mainfile), std::runtime_error);
+	}
+
+	unlink(mainfile.c_str());
+	unlink(includedfile.c_str());
+	unlink(compiledfile.c_str());
+	rmdir(dirname);
+END_TEST()
@@ -0,0 +1,146 @@
+/*
+ * Copyright (C) 2011-2016 Dmitry Marakasov
+ *
+ * This file is part of streetmangler.
+ *
+ * streetmangler is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * streetmangler is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with streetmangler.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include <fstream>
+#include <string>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <stdexcept>
+
+#include <unistd.h>
+#include <stdlib.h>
+
+#include <streetmangler/databasehandle.hh>
+#include <streetmangler/locale.hh>
+#include "database_testing.hh"
+
+static void WriteNames(const std::string& filename, const std::vector<std::string>& names) {
+	std::ofstream out(filename.c_str());
+	for (std::vector<std::string>::const_iterator name = names.begin(); name != names.end(); ++name)
+		out << *name << std::endl;
+}
+
+BEGIN_TEST()
+	using StreetMangler::Database;
+	using StreetMangler::DatabaseHandle;
+	using StreetMangler::Locale;
+
+	/* assumes working locale, see locale_test */
+	Locale locale("ru_RU");
+
+	char dirname[] = "/tmp/reload_test.XXXXXX";
+	EXPECT_TRUE(mkdtemp(dirname) != NULL);
+
+	const std::string datafile = std::string(dirname) + "/names.txt";
+	const std::string compiledfile = std::string(dirname) + "/names.db";
+
+	DatabaseHandle handle(locale);
+
+	/* empty until loaded */
+	EXPECT_TRUE(handle.Get() != nullptr);
+	EXPECT_INT(handle.Get()->CheckExactMatch("улица Ленина"), 0);
+
+	WriteNames(datafile, std::vector<std::string>(1, "улица Ленина"));
+	handle.Reload(std::vector<std::string>(1, datafile));
+
+	DatabaseHandle::Snapshot first = handle.Get();
+	EXPECT_INT(first->CheckExactMatch("улица Ленина"), 1);
+
+	/* failed reload keeps current snapshot */
+	EXPECT_EXCEPTION(handle.Reload(std::vector<std::string>(1, std::string(dirname) + "/missing.txt")), std::runtime_error);
+	EXPECT_TRUE(handle.Get() == first);
+
+	/* new snapshot is published, while old one stays usable for its readers */
+	{
+		std::vector<std::string> names;
+		names.push_back("улица Ленина");
+		names.push_back("Зелёная улица");
+		WriteNames(datafile, names);
+	}
+
+	handle.StartReload(std::vector<std::string>(1, datafile));
+	handle.WaitReload();
+
+	EXPECT_TRUE(handle.Get() != first);
+	EXPECT_INT(handle.Get()->CheckExactMatch("Зелёная улица"), 1);
+	EXPECT_INT(first->CheckExactMatch("Зелёная улица"), 0);
+	EXPECT_INT(first->CheckExactMatch("улица Ленина"), 1);
+
+	/* compiled databases are loaded by extension */
+	handle.Get()->WriteCompiled(compiledfile);
+	handle.Reload(std::vector<std::string>(1, compiledfile));
+	EXPECT_INT(handle.Get()->CheckExactMatch("Зелёная улица"), 1);
+
+	/* background reload error is reported by WaitReload */
+	handle.StartReload(std::vector<std::string>(1, std::string(dirname) + "/missing.txt"));
+	EXPECT_EXCEPTION(handle.WaitReload(), std::runtime_error);
+	EXPECT_INT(handle.Get()->CheckExactMatch("Зелёная улица"), 1);
+
+	/* unreported background error doesn't fail next reloads */
+	handle.StartReload(std::vector<std::string>(1, std::string(dirname) + "/missing.txt"));
+	EXPECT_NO_EXCEPTION(handle.Reload(std::vector<std::string>(1, datafile)));
+	EXPECT_INT(handle.Get()->CheckExactMatch("Зелёная улица"), 1);
+
+	handle.StartReload(std::vector<std::string>(1, std::string(dirname) + "/missing.txt"));
+	EXPECT_NO_EXCEPTION(handle.StartReload(std::vector<std::string>(1, datafile)));
+	EXPECT_NO_EXCEPTION(handle.WaitReload());
+
+	/* readers always see complete snapshot while reloads go on */
+	{
+		std::atomic<bool> done(false);
+		std::vector<int> failures(4);
+		std::vector<std::thread> readers;
+		for (size_t t = 0; t < failures.size(); ++t) {
+			readers.push_back(std::thread([&, t]() {
+				while (!done) {
+					DatabaseHandle::Snapshot snapshot = handle.Get();
+					std::vector<std::string> suggestions;
+					if (snapshot->CheckExactMatch("улица Ленина") != 1 || snapshot->CheckCanonicalForm("ленина улица", suggestions) != 1)
+						++failures[t];
+				}
+			}));
+		}
+
+		for (int i = 0; i < 10; ++i) {
+			handle.StartReload(std::vector<std::string>(1, i % 2 ? datafile : compiledfile));
+			handle.WaitReload();
+		}
+
+		done = true;
+		for (size_t t = 0; t < readers.size(); ++t)
+			readers[t].join();
+
+		for (size_t t = 0; t < failures.size(); ++t)
+			EXPECT_INT(failures[t], 0);
+	}
+
+	/* only handle refers to current snapshot, so it is freed once replaced */
+	{
+		std::weak_ptr<const Database> previous = handle.Get();
+		first.reset();
+		handle.Reload(std::vector<std::string>(1, datafile));
+		EXPECT_TRUE(previous.expired());
+	}
+
+	unlink(datafile.c_str());
+	unlink(compiledfile.c_str());
+	rmdir(dirname);
+END_TEST()
@@ -0,0 +1,155 @@
+/*
+ * Copyright (C) 2011-2016 Dmitry Marakasov
+ *
+ * This file is part of streetmangler.
+ *
+ * streetmangler is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * streetmangler is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with streetmangler.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <streetmangler/database.hh>
+#include <streetmangler/locale.hh>
+#include "database_testing.hh"
+
+BEGIN_TEST()
+	using StreetMangler::Database;
+	using StreetMangler::Locale;
+
+	/* assumes working locale, see locale_test */
+	Locale locale("ru_RU");
+
+	/* all spelling engines should produce the same results */
+	static const Database::SpellingEngine engines[] = {
+		Database::ENGINE_TRIE,
+		Database::ENGINE_AUTOMATON,
+		Database::ENGINE_DELETIONS,
+		Database::ENGINE_BKTREE,
+	};
+
+	for (const Database::SpellingEngine* engine = engines; engine != engines + sizeof(engines)/sizeof(engines[0]); ++engine) {
+		std::cerr << "Engine " << *engine << std::endl;
+
+		Database db(locale, *engine);
+
+		db.Add("улица Ленина");
+		db.Add("Зелёная улица");
+		db.Add("улица Льва Толстого");
+		db.Add("улица Лебедева-Кумача");
+		db.Add("улица Верхний переулок");
+		db.Add("Учительская улица");
+		db.Add("улица Петра Безымянного");
+		db.Add("улица Петро Безымянного");
+		db.Add("1-я улица Строителей");
+		db.Add("улица 3-го Интернационала");
+
+		CHECK_SPELLING(db, "улица Ленена", "улица Ленина", 1);
+		CHECK_SPELLING(db, "улица Ленна", "улица Ленина", 1);
+		CHECK_SPELLING(db, "улица Ленинаа", "улица Ленина", 1);
+		CHECK_SPELLING(db, "улица Леинна", "улица Ленина", 1);
+		CHECK_SPELLING(db, "уилца Ленина", "улица Ленина", 1);
+		CHECK_SPELLING(db, "улица Лениан", "улица Ленина", 1);
+		CHECK_SPELLING(db, "улица Леинан", "улица Ленина", 2); /* two swaps */
+		CHECK_SPELLING(db, "Учительская улицца", "Учительская улица", 1);
+		CHECK_SPELLING(db, "Зеленая улица", "Зелёная улица", 0);
+		CHECK_SPELLING(db, "улица Безымянного Петра", "улица Петра Безымянного", 0);
+
+		CHECK_NO_SPELLING(db, "улица Феника", 1);
+		CHECK_NO_SPELLING(db, "ууулица Ленина", 1);
+		CHECK_SPELLING(db, "улица Феника", "улица Ленина", 2);
+		CHECK_SPELLING(db, "ууулица Ленина", "улица Ленина", 2);
+		CHECK_SPELLING(db, "улица Линена", "улица Ленина", 2);
+		CHECK_SPELLING(db, "уууулица Ленина", "улица Ленина", 3);
+
+		CHECK_SPELLING(db, "Толстого Льва улица", "улица Льва Толстого", 1);
+		CHECK_SPELLING(db, "улица Лебедева Кумача", "улица Лебедева-Кумача", 1);
+		CHECK_SPELLING(db, "улицаленина", "улица Ленина", 1);
+
+		CHECK_SPELLING(db, "1-й улица Строителей", "1-я улица Строителей", 1);
+		CHECK_SPELLING(db, "-я улица Строителей", "1-я улица Строителей", 1);
+		CHECK_NO_SPELLING(db, "2-я улица Строителей", 2);
+		CHECK_NO_SPELLING(db, "21-я улица Строителей", 2);
+		CHECK_SPELLING(db, "улица -го Интернационала", "улица 3-го Интернационала", 1);
+
+		/* empty query */
+		CHECK_NO_SPELLING(db, "", 0);
+		CHECK_NO_SPELLING(db, "", 1);
+		CHECK_NO_SPELLING(db, "", 2);
+
+		/* result count limit */
+		{
+			std::vector<std::string> suggestions;
+			EXPECT_INT(db.CheckSpelling("улица Петр Безымянного", suggestions, 1), 2);
+			suggestions.clear();
+			EXPECT_INT(db.CheckSpelling("улица Петр Безымянного", suggestions, 1, 1), 1);
+			EXPECT_INT(db.CheckSpelling("улица Петр Безымянного", suggestions, 1, 5), 2);
+		}
+
+		/* batch lookup should give the same results as single ones */
+		{
+			static const char* queries[] = {
+				"улица Ленена",
+				"улица Феника",
+				"Зеленая улица",
+				"улица Петр Безымянного",
+				"улица Горкого",
+				"21-я улица Строителей",
+				"Толстого Льва улица",
+				"",
+			};
+
+			std::vector<std::string> names(queries, queries + sizeof(queries)/sizeof(queries[0]));
+			std::vector<std::vector<std::string> > batch;
+
+			EXPECT_INT(db.CheckSpellingBatch(names, batch, 2), 5);
+			EXPECT_TRUE(batch.size() == names.size());
+
+			for (size_t i = 0; i < names.size() && i < batch.size(); ++i) {
+				std::vector<std::string> single;
+				db.CheckSpelling(names[i], single, 2);
+				EXPECT_TRUE(batch[i] == single);
+			}
+
+			/* batches larger than a single walk are split */
+			std::vector<std::string> many;
+			for (int i = 0; i < 100; ++i)
+				many.insert(many.end(), names.begin(), names.end());
+
+			std::vector<std::vector<std::string> > manybatch;
+
+			EXPECT_INT(db.CheckSpellingBatch(many, manybatch, 2), 500);
+			EXPECT_TRUE(manybatch.size() == many.size());
+
+			for (size_t i = 0; i < many.size() && i < manybatch.size(); ++i)
+				EXPECT_TRUE(manybatch[i] == batch[i % names.size()]);
+		}
+
+		/* adding after lookups should be picked up */
+		CHECK_NO_SPELLING(db, "улица Горкого", 1);
+		db.Add("улица Горького");
+		CHECK_SPELLING(db, "улица Горкого", "улица Горького", 1);
+	}
+
+	{
+		/* deletion index covering distance 2 */
+		Database db(locale, Database::ENGINE_DELETIONS, 2);
+
+		db.Add("улица Ленина");
+		db.Add("1-я улица Строителей");
+
+		CHECK_SPELLING(db, "улица Феника", "улица Ленина", 2);
+		CHECK_SPELLING(db, "улица Леинан", "улица Ленина", 2);
+		CHECK_NO_SPELLING(db, "улица Феникс", 2);
+		CHECK_NO_SPELLING(db, "21-я улица Строителей", 2);
+		CHECK_SPELLING(db, "ууулица Лениина", "улица Ленина", 3); /* falls back to trie */
+	}
+END_TEST()
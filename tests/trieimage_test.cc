@@ -0,0 +1,155 @@
+/*
+ * Copyright (C) 2011-2016 Dmitry Marakasov
+ *
+ * This file is part of streetmangler.
+ *
+ * streetmangler is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * streetmangler is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with streetmangler.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <tspell/utf8trie.hh>
+#include <tspell/mappedfile.hh>
+
+#include "testing.hh"
+
+namespace {
+
+std::vector<uint32_t> FindApprox(const TSpell::Utf8Trie& trie, const std::string& string, int distance) {
+	std::vector<uint32_t> result;
+	trie.FindApprox(string, distance, result);
+	std::sort(result.begin(), result.end());
+	return result;
+}
+
+}
+
+BEGIN_TEST()
+	TSpell::Utf8Trie source;
+	source.Insert("улица ленина", 0);
+	source.Insert("улица лебедева", 1);
+	source.Insert("зелёная улица", 2);
+
+	std::ostringstream stream;
+	source.WriteImage(stream);
+	const std::string image = stream.str();
+
+	EXPECT_TRUE(image.size() == source.GetImageSize());
+
+	{
+		/* image only depends on trie contents */
+		TSpell::Utf8Trie same;
+		same.Insert("зелёная улица", 2);
+		same.Insert("улица лебедева", 1);
+		same.Insert("улица ленина", 0);
+
+		std::ostringstream samestream;
+		same.WriteImage(samestream);
+		EXPECT_TRUE(samestream.str() == image);
+	}
+
+	{
+		/* used in place */
+		TSpell::Utf8Trie trie;
+		EXPECT_TRUE(trie.MapImage(image.data(), image.size(), 3));
+
+		EXPECT_TRUE(trie.FindExact("улица ленина"));
+		EXPECT_TRUE(trie.FindExact("зелёная улица"));
+		EXPECT_TRUE(!trie.FindExact("улица"));
+		EXPECT_TRUE(FindApprox(trie, "улица ленена", 1) == std::vector<uint32_t>(1, 0));
+		EXPECT_TRUE(FindApprox(trie, "зеленая улица", 1) == std::vector<uint32_t>(1, 2));
+		EXPECT_TRUE(FindApprox(trie, "улица ле", 3).empty());
+		EXPECT_TRUE(FindApprox(trie, "улица ле", 6).size() == 2);
+		EXPECT_TRUE(FindApprox(trie, "", 0).empty());
+		EXPECT_TRUE(FindApprox(trie, "", 2).empty());
+
+		/* insertion unpacks the image */
+		EXPECT_TRUE(trie.Insert("улица горького", 3) == 3);
+		EXPECT_TRUE(trie.Insert("улица ленина", 4) == 0);
+		EXPECT_TRUE(FindApprox(trie, "улица горкого", 1) == std::vector<uint32_t>(1, 3));
+		EXPECT_TRUE(FindApprox(trie, "улица ленена", 1) == std::vector<uint32_t>(1, 0));
+	}
+
+	{
+		/* malformed images are rejected */
+		TSpell::Utf8Trie trie;
+		trie.Insert("улица ленина", 0);
+
+		EXPECT_TRUE(!trie.MapImage(image.data(), image.size() - 1));
+		EXPECT_TRUE(!trie.MapImage(image.data(), 4));
+
+		std::string corrupt = image;
+		corrupt[0] = 'X';
+		EXPECT_TRUE(!trie.MapImage(corrupt.data(), corrupt.size()));
+
+		/* payloads must be below given limit */
+		EXPECT_TRUE(!trie.MapImage(image.data(), image.size(), 2));
+
+		/* trie is left intact */
+		EXPECT_TRUE(trie.FindExact("улица ленина"));
+	}
+
+	{
+		/* empty query only reaches keys within distance from nothing */
+		TSpell::Utf8Trie trie;
+		trie.Insert("я", 0);
+		trie.Insert("ул", 1);
+
+		EXPECT_TRUE(FindApprox(trie, "", 0).empty());
+		EXPECT_TRUE(FindApprox(trie, "", 1) == std::vector<uint32_t>(1, 0));
+		EXPECT_TRUE(FindApprox(trie, "", 2).size() == 2);
+	}
+
+	{
+		/* empty trie */
+		TSpell::Utf8Trie empty;
+		std::ostringstream emptystream;
+		empty.WriteImage(emptystream);
+		const std::string emptyimage = emptystream.str();
+
+		TSpell::Utf8Trie trie;
+		EXPECT_TRUE(trie.MapImage(emptyimage.data(), emptyimage.size()));
+		EXPECT_TRUE(!trie.FindExact("улица ленина"));
+		EXPECT_TRUE(FindApprox(trie, "улица ленина", 2).empty());
+	}
+
+	{
+		/* memory mapped file */
+		char filename[] = "/tmp/trieimage_test.XXXXXX";
+		int fd = mkstemp(filename);
+		EXPECT_TRUE(fd != -1);
+		close(fd);
+
+		{
+			std::ofstream out(filename, std::ios::binary);
+			source.WriteImage(out);
+		}
+
+		{
+			TSpell::MappedFile file(filename);
+			TSpell::Utf8Trie trie;
+			EXPECT_TRUE(trie.MapImage(file.GetData(), file.GetSize()));
+			EXPECT_TRUE(FindApprox(trie, "улица лебедва", 1) == std::vector<uint32_t>(1, 1));
+		}
+
+		unlink(filename);
+	}
+END_TEST()
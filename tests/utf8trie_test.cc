@@ -0,0 +1,137 @@
+/*
+ * Copyright (C) 2011-2016 Dmitry Marakasov
+ *
+ * This file is part of streetmangler.
+ *
+ * streetmangler is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * streetmangler is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with streetmangler.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include <stdlib.h>
+
+#include <tspell/distance.hh>
+#include <tspell/utf8trie.hh>
+
+#include "testing.hh"
+
+namespace {
+
+std::vector<uint32_t> FindApprox(const TSpell::Utf8Trie& trie, const std::string& string, int distance) {
+	std::vector<uint32_t> result;
+	trie.FindApprox(string, distance, result);
+	std::sort(result.begin(), result.end());
+	return result;
+}
+
+/* reference decoder: complete sequences are characters, any other
+ * byte is a character on its own */
+std::vector<uint32_t> Decode(const std::string& string) {
+	std::vector<uint32_t> result;
+	for (size_t i = 0; i < string.length(); ) {
+		const unsigned char byte = string[i];
+		size_t length = byte < 0x80 ? 1 : byte < 0xc0 ? 0 : byte < 0xe0 ? 2 : byte < 0xf0 ? 3 : byte < 0xf8 ? 4 : 0;
+
+		size_t j = 1;
+		while (j < length && i + j < string.length() && ((unsigned char)string[i + j] & 0xc0) == 0x80)
+			++j;
+
+		if (length == 0 || j < length) {
+			result.push_back(0x80000000U | byte);
+			++i;
+		} else {
+			/* any value unique to the sequence will do for distances */
+			uint32_t ch = 0;
+			for (; j > 0; --j, ++i)
+				ch = (ch << 8) | (unsigned char)string[i];
+			result.push_back(ch);
+		}
+	}
+	return result;
+}
+
+}
+
+BEGIN_TEST()
+	{
+		/* multibyte characters count as single edits */
+		TSpell::Utf8Trie trie;
+		trie.Insert("улица", 0);
+		trie.Insert("улиса", 1);
+
+		EXPECT_TRUE(FindApprox(trie, "улица", 0) == std::vector<uint32_t>(1, 0));
+		EXPECT_TRUE(FindApprox(trie, "улида", 1).size() == 2);
+		EXPECT_TRUE(FindApprox(trie, "уилца", 1) == std::vector<uint32_t>(1, 0));
+		EXPECT_TRUE(FindApprox(trie, "улца", 1) == std::vector<uint32_t>(1, 0));
+	}
+
+	{
+		/* malformed keys are found as sequences of separate bytes */
+		TSpell::Utf8Trie trie;
+		trie.Insert("\xd1x", 0);        /* lead byte followed by ascii */
+		trie.Insert("ab\xd0", 1);       /* key ends inside a sequence */
+		trie.Insert("\x80" "cde", 2);   /* stray continuation byte */
+		trie.Insert("\xe0\x80z", 3);    /* sequence broken after continuation */
+
+		EXPECT_TRUE(FindApprox(trie, "\xd1x", 0) == std::vector<uint32_t>(1, 0));
+		EXPECT_TRUE(FindApprox(trie, "x", 1) == std::vector<uint32_t>(1, 0));
+		EXPECT_TRUE(FindApprox(trie, "ab\xd0", 0) == std::vector<uint32_t>(1, 1));
+		EXPECT_TRUE(FindApprox(trie, "ab", 0).empty());
+		EXPECT_TRUE(FindApprox(trie, "ab", 1) == std::vector<uint32_t>(1, 1));
+		EXPECT_TRUE(FindApprox(trie, "cde", 1) == std::vector<uint32_t>(1, 2));
+		EXPECT_TRUE(FindApprox(trie, "\xe0\x80z", 0) == std::vector<uint32_t>(1, 3));
+		EXPECT_TRUE(FindApprox(trie, "z", 1).empty());
+		EXPECT_TRUE(FindApprox(trie, "z", 2).size() == 2); /* also "\xd1x" */
+	}
+
+	{
+		/* random well formed and malformed keys against brute force */
+		static const char bytes[] = { 'a', 'b', '\xd0', '\xd1', '\x80', '\xb0', '\xe0' };
+
+		srand(1);
+		std::vector<std::string> keys;
+		TSpell::Utf8Trie trie;
+		for (uint32_t i = 0; i < 300; ++i) {
+			std::string key;
+			for (int length = 1 + rand() % 6; length > 0; --length)
+				key += bytes[rand() % sizeof(bytes)];
+			if (trie.Insert(key, keys.size()) == keys.size())
+				keys.push_back(key);
+		}
+
+		int mismatches = 0;
+		for (int n = 0; n < 300; ++n) {
+			std::string query;
+			for (int length = rand() % 7; length > 0; --length)
+				query += bytes[rand() % sizeof(bytes)];
+			const std::vector<uint32_t> decodedquery = Decode(query);
+
+			for (int distance = 0; distance <= 2; ++distance) {
+				std::vector<uint32_t> expected;
+				for (uint32_t id = 0; id < keys.size(); ++id) {
+					const std::vector<uint32_t> decodedkey = Decode(keys[id]);
+					if (TSpell::BoundedDistance(decodedquery.data(), decodedquery.size(), decodedkey.data(), decodedkey.size(), distance) <= distance)
+						expected.push_back(id);
+				}
+
+				if (FindApprox(trie, query, distance) != expected)
+					++mismatches;
+			}
+		}
+		EXPECT_INT(mismatches, 0);
+	}
+END_TEST()
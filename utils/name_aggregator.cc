@@ -57,40 +57,40 @@ void NameAggregator::ProcessName(const std::string& name) {
 	}
 
 	/* miscellaneous types of mismatch */
-	std::vector<std::string> suggestions;
+	StreetMangler::Database::ClassifyResult result;
 	StreetMangler::Name tokenized(name, database_.GetLocale());
 
-	if (database_.CheckCanonicalForm(tokenized, suggestions)) {
-		++count_canonical_form_;
+	switch (database_.Classify(tokenized, result, spelldistance_)) {
+	case StreetMangler::Database::EXACT_MATCH:
+		/* not reached, checked above */
+		break;
+	case StreetMangler::Database::CANONICAL_FORM: {
+			++count_canonical_form_;
 
-		std::pair<MultiSuggestionMap::iterator, bool> insresult =
-			canonical_form_.insert(std::make_pair(name, std::vector<std::string>()));
-
-		/* in -s mode it's possible that the map already contains suggestions for
-		 * this street; just ignore it then, as suggestions vertor will be the same */
-		if (insresult.second)
-			suggestions.swap(insresult.first->second);
+			std::pair<MultiSuggestionMap::iterator, bool> insresult =
+				canonical_form_.insert(std::make_pair(name, std::vector<std::string>()));
 
+			/* in -s mode it's possible that the map already contains suggestions for
+			 * this street; just ignore it then, as suggestions vertor will be the same */
+			if (insresult.second)
+				result.suggestions.swap(insresult.first->second);
+		}
 		return;
-	}
-
-	if (database_.CheckSpelling(tokenized, suggestions, spelldistance_)) {
-		++count_spelling_fixed_;
-
-		std::pair<MultiSuggestionMap::iterator, bool> insresult =
-			spelling_fixed_.insert(std::make_pair(name, std::vector<std::string>()));
-		/* in -s mode it's possible that the map already contains suggestions for
-		 * this street; just ignore it then, as suggestions vertor will be the same */
-		if (insresult.second)
-			suggestions.swap(insresult.first->second);
-
-		if (flags_ & COUNT_NAMES)
-			++counts_spelling_fixed_[name];
-
+	case StreetMangler::Database::SPELLING_FIXED: {
+			++count_spelling_fixed_;
+
+			std::pair<MultiSuggestionMap::iterator, bool> insresult =
+				spelling_fixed_.insert(std::make_pair(name, std::vector<std::string>()));
+			/* in -s mode it's possible that the map already contains suggestions for
+			 * this street; just ignore it then, as suggestions vertor will be the same */
+			if (insresult.second)
+				result.suggestions.swap(insresult.first->second);
+
+			if (flags_ & COUNT_NAMES)
+				++counts_spelling_fixed_[name];
+		}
 		return;
-	}
-
-	if (database_.CheckStrippedStatus(tokenized, suggestions)) {
+	case StreetMangler::Database::STRIPPED_STATUS:
 		++count_stripped_status_;
 		stripped_status_.insert(name);
 
@@ -98,6 +98,8 @@ void NameAggregator::ProcessName(const std::string& name) {
 			++counts_stripped_status_[name];
 
 		return;
+	case StreetMangler::Database::NO_MATCH:
+		break;
 	}
 
 	if (tokenized.HasStatusPart()) {
@@ -18,6 +18,7 @@
  */
 
 #include <vector>
+#include <cstdio>
 #include <cstdlib>
 #include <iostream>
 #include <exception>
@@ -80,17 +81,55 @@ protected:
 	}
 };
 
+static void DumpHistogram(const char* title, const std::vector<size_t>& histogram) {
+	fprintf(stderr, "%s:", title);
+	for (size_t i = 0; i < histogram.size(); ++i)
+		if (histogram[i] != 0)
+			fprintf(stderr, " %d:%lu", (int)i, (unsigned long)histogram[i]);
+	fprintf(stderr, "\n");
+}
+
+static void DumpDatabaseStats(const StreetMangler::Database& database) {
+	StreetMangler::Database::Stats stats = database.GetStats();
+
+	struct {
+		const char* name;
+		const StreetMangler::Database::IndexStats& index;
+	} indexes[] = {
+		{ "names", stats.names },
+		{ "canonical_map", stats.canonical_map },
+		{ "stripped_map", stats.stripped_map },
+		{ "spelling_map", stats.spelling_map },
+		{ "deletion_index", stats.deletion_index },
+		{ "bk_tree", stats.bk_tree },
+	};
+
+	fprintf(stderr, "Database statistics:\n");
+	fprintf(stderr, "          Index     Keys   Values      Bytes\n");
+	for (size_t i = 0; i < sizeof(indexes)/sizeof(indexes[0]); ++i)
+		fprintf(stderr, "%15s %8lu %8lu %10lu\n", indexes[i].name, (unsigned long)indexes[i].index.keys, (unsigned long)indexes[i].index.values, (unsigned long)indexes[i].index.bytes);
+	fprintf(stderr, "          Index    Nodes   Labels      Bytes\n");
+	fprintf(stderr, "%15s %8lu %8lu %10lu\n", "spell_trie", (unsigned long)stats.spell_trie.nodes, (unsigned long)stats.spell_trie.labels, (unsigned long)stats.spell_trie.bytes);
+	if (stats.deletion_index.buckets != 0)
+		fprintf(stderr, "Deletion index buckets: %lu\n", (unsigned long)stats.deletion_index.buckets);
+	fprintf(stderr, "Compiled image: %lu bytes\n", (unsigned long)stats.image_bytes);
+	DumpHistogram("Trie fanout (children:nodes)", stats.spell_trie.fanout);
+	DumpHistogram("Trie depth (depth:nodes)", stats.spell_trie.depth);
+}
+
 int usage(const char* progname, int exitcode) {
-	std::cerr << "Usage: " << progname << " [-h] [-cdsAN] [-l locale] [-p depth] [[-a tag] ...] [[-r type] ...] [[-n tag] ...] [[-f database] ...] file.osm|file.txt|- ..." << std::endl;
+	std::cerr << "Usage: " << progname << " [-h] [-cdisAN] [-l locale] [-p depth] [[-a tag] ...] [[-r type] ...] [[-n tag] ...] [[-f database] ...] file.osm|file.txt|- ..." << std::endl;
 	std::cerr << "  -s  display per-street statistics (takes extra time)" << std::endl;
 	std::cerr << "  -d  dump street lists into dump.*" << std::endl;
-	std::cerr << "  -c  include dumps with street name counts" << std::endl << std::endl;
+	std::cerr << "  -c  include dumps with street name counts" << std::endl;
+	std::cerr << "  -i  display database index statistics" << std::endl << std::endl;
 
 	std::cerr << "  -l  set locale (default \"" DEFAULT_LOCALE "\")" << std::endl;
 	std::cerr << "  -p  spelling check distance (default 1)" << std::endl << std::endl;
 
 	std::cerr << "  -f  specify path to street names database (default " DATADIR "/<locale>.txt)" << std::endl;
-	std::cerr << "      (may be specified more than once)" << std::endl << std::endl;
+	std::cerr << "      (may be specified more than once; compiled database (*.db, see" << std::endl;
+	std::cerr << "      streetmangler-compile) must come first)" << std::endl << std::endl;
 
 	std::cerr << "  -a  specify addr tag(s) instead of default set (\"addrN:streetN\" variants)" << std::endl;
 	std::cerr << "  -n  specify name tag(s) instead of default set (\"name\")" << std::endl;
@@ -107,6 +146,7 @@ int realmain(int argc, char** argv) {
 	const char* progname = argv[0];
 	const char* localename = DEFAULT_LOCALE;
 	bool dumpflag = false;
+	bool indexstatsflag = false;
 	int flags = 0;
 	int spelldistance = 1;
 	bool use_default_addr_tags = true;
@@ -119,10 +159,11 @@ int realmain(int argc, char** argv) {
 
 	/* process options */
 	int c;
-	while ((c = getopt(argc, argv, "sdhf:l:p:n:a:r:cNA")) != -1) {
+	while ((c = getopt(argc, argv, "sdihf:l:p:n:a:r:cNA")) != -1) {
 		switch (c) {
 			case 's': flags |= NameAggregator::PERSTREET_STATS; break;
 			case 'd': dumpflag = true; break;
+			case 'i': indexstatsflag = true; break;
 			case 'f': datafiles.push_back(optarg); break;
 			case 'n': name_tags.push_back(optarg); break;
 			case 'l': localename = optarg; break;
@@ -167,12 +208,18 @@ int realmain(int argc, char** argv) {
 	for (std::vector<std::string>::const_iterator i = datafiles.begin(); i != datafiles.end(); ++i) {
 		std::cerr << "Loading dictionary \"" << *i << "\"..." << std::endl;
 		try {
-			database.Load(*i);
+			if (i->length() > 3 && i->rfind(".db") == i->length() - 3)
+				database.LoadCompiled(*i);
+			else
+				database.Load(*i);
 		} catch (std::exception &e) {
 			std::cerr << "Cannot load dictionary \"" << *i << "\": " << e.what() << ", ignoring" << std::endl;
 		}
 	}
 
+	if (indexstatsflag)
+		DumpDatabaseStats(database);
+
 	/* create tag aggregator */
 	NameAggregator aggregator(database, flags, spelldistance);
 
@@ -0,0 +1,282 @@
+/*
+ * Copyright (C) 2011-2013 Dmitry Marakasov
+ *
+ * This file is part of streetmangler.
+ *
+ * streetmangler is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * streetmangler is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with streetmangler.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <vector>
+#include <string>
+#include <random>
+#include <chrono>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <exception>
+
+#include <getopt.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <sys/resource.h>
+
+#include <unicode/unistr.h>
+
+#include <streetmangler/locale.hh>
+#include <streetmangler/database.hh>
+#include <streetmangler/stringlistparser.hh>
+
+#ifndef DATADIR
+#	define DATADIR "."
+#endif
+
+#ifndef DEFAULT_LOCALE
+#	define DEFAULT_LOCALE "ru_RU"
+#endif
+
+struct EngineInfo {
+	const char* name;
+	StreetMangler::Database::SpellingEngine engine;
+};
+
+static const EngineInfo engines[] = {
+	{ "trie", StreetMangler::Database::ENGINE_TRIE },
+	{ "automaton", StreetMangler::Database::ENGINE_AUTOMATON },
+	{ "deletions", StreetMangler::Database::ENGINE_DELETIONS },
+	{ "bktree", StreetMangler::Database::ENGINE_BKTREE },
+};
+
+class NameCollector : public StreetMangler::StringListParser {
+private:
+	std::vector<std::string>& names_;
+
+public:
+	NameCollector(const std::string& filename, std::vector<std::string>& names) : StreetMangler::StringListParser(filename), names_(names) {
+	}
+
+protected:
+	virtual void ProcessString(const std::string& string) {
+		if (string.find(".include") == 0) {
+			/* follow includes the same way Database::Load does */
+			size_t filepos = strlen(".include");
+			while (filepos < string.length() && (string[filepos] == ' ' || string[filepos] == '\t'))
+				++filepos;
+
+			size_t slashpos = filename_.rfind("/");
+
+			std::string newname;
+			if (slashpos != std::string::npos)
+				newname = filename_.substr(0, slashpos + 1);
+			newname += string.substr(filepos);
+
+			NameCollector(newname, names_).Parse();
+		} else {
+			names_.push_back(string);
+		}
+	}
+};
+
+/* applies exactly `edits' random insertions, deletions or substitutions */
+static std::string Misspell(const std::string& name, int edits, std::mt19937& rng) {
+	static const UChar alphabet[] = {
+		0x430, 0x431, 0x432, 0x433, 0x434, 0x435, 0x436, 0x437,
+		0x438, 0x439, 0x43a, 0x43b, 0x43c, 0x43d, 0x43e, 0x43f,
+		0x440, 0x441, 0x442, 0x443, 0x444, 0x445, 0x446, 0x447,
+		0x448, 0x449, 0x44a, 0x44b, 0x44c, 0x44d, 0x44e, 0x44f,
+	};
+
+	icu::UnicodeString string = icu::UnicodeString::fromUTF8(name);
+
+	for (int i = 0; i < edits && string.length() > 1; i++) {
+		int pos = std::uniform_int_distribution<int>(0, string.length() - 1)(rng);
+		UChar ch = alphabet[std::uniform_int_distribution<int>(0, sizeof(alphabet)/sizeof(alphabet[0]) - 1)(rng)];
+
+		switch (std::uniform_int_distribution<int>(0, 2)(rng)) {
+		case 0: string.insert(pos, ch); break;
+		case 1: string.remove(pos, 1); break;
+		case 2: string.setCharAt(pos, ch); break;
+		}
+	}
+
+	std::string result;
+	string.toUTF8String(result);
+	return result;
+}
+
+static double Percentile(std::vector<double>& samples, double fraction) {
+	if (samples.empty())
+		return 0.0;
+	size_t n = std::min(samples.size() - 1, (size_t)(samples.size() * fraction));
+	std::nth_element(samples.begin(), samples.begin() + n, samples.end());
+	return samples[n];
+}
+
+/* runs in a separate process, so peak RSS reflects single engine */
+static void RunEngine(const EngineInfo& info, const std::string& datafile, const std::vector<std::string>& queries, const std::vector<int>& depths, int index_depth, bool batch) {
+	typedef std::chrono::steady_clock Clock;
+
+	StreetMangler::Locale locale(DEFAULT_LOCALE);
+
+	struct rusage usage;
+	getrusage(RUSAGE_SELF, &usage);
+	long rss_before = usage.ru_maxrss;
+
+	Clock::time_point start = Clock::now();
+	StreetMangler::Database db(locale, info.engine, index_depth);
+	db.Load(datafile);
+	double build = std::chrono::duration<double>(Clock::now() - start).count();
+
+	getrusage(RUSAGE_SELF, &usage);
+	long rss = usage.ru_maxrss - rss_before;
+
+	for (std::vector<int>::const_iterator depth = depths.begin(); depth != depths.end(); ++depth) {
+		std::vector<double> latencies;
+		latencies.reserve(queries.size());
+
+		std::vector<std::string> suggestions;
+		for (std::vector<std::string>::const_iterator query = queries.begin(); query != queries.end(); ++query) {
+			suggestions.clear();
+			Clock::time_point qstart = Clock::now();
+			db.CheckSpelling(*query, suggestions, *depth);
+			latencies.push_back(std::chrono::duration<double, std::micro>(Clock::now() - qstart).count());
+		}
+
+		double total = 0.0;
+		for (std::vector<double>::const_iterator l = latencies.begin(); l != latencies.end(); ++l)
+			total += *l;
+
+		fprintf(stdout, "%-10s %5d %9.3f %9ld %11.1f %11.1f %11.1f\n",
+				info.name, *depth, build, rss / 1024,
+				Percentile(latencies, 0.5), Percentile(latencies, 0.99),
+				latencies.empty() ? 0.0 : total / latencies.size());
+		fflush(stdout);
+
+		if (batch) {
+			std::vector<std::vector<std::string> > batch_suggestions;
+			Clock::time_point bstart = Clock::now();
+			db.CheckSpellingBatch(queries, batch_suggestions, *depth);
+			double batch_total = std::chrono::duration<double, std::micro>(Clock::now() - bstart).count();
+
+			fprintf(stdout, "%-10s %5d %9s %9s %11s %11s %11.1f\n",
+					"  batch", *depth, "", "", "", "",
+					queries.empty() ? 0.0 : batch_total / queries.size());
+			fflush(stdout);
+		}
+	}
+}
+
+int usage(const char* progname, int exitcode) {
+	std::cerr << "Usage: " << progname << " [-h] [-n count] [-p depth] [-i depth] [-s seed] [-b] [[-e engine] ...] [database]" << std::endl;
+	std::cerr << "  -n  number of misspelled queries (default 1000)" << std::endl;
+	std::cerr << "  -p  maximal spelling check distance (default 3)" << std::endl;
+	std::cerr << "  -i  deletion index depth (default 1)" << std::endl;
+	std::cerr << "  -s  random seed (default 1)" << std::endl;
+	std::cerr << "  -b  also time batch lookup of all queries" << std::endl;
+	std::cerr << "  -e  benchmark only given engine(s) (trie, automaton, deletions, bktree)" << std::endl << std::endl;
+
+	std::cerr << "  database defaults to " DATADIR "/" DEFAULT_LOCALE ".txt; queries are made" << std::endl;
+	std::cerr << "  by misspelling random names from it" << std::endl << std::endl;
+
+	std::cerr << "  -h  display this help" << std::endl;
+
+	exit(exitcode);
+}
+
+int realmain(int argc, char** argv) {
+	const char* progname = argv[0];
+	int count = 1000;
+	int maxdepth = 3;
+	int index_depth = 1;
+	unsigned int seed = 1;
+	bool batch = false;
+	std::vector<std::string> engine_names;
+
+	int c;
+	while ((c = getopt(argc, argv, "hn:p:i:s:be:")) != -1) {
+		switch (c) {
+			case 'n': count = (int)strtoul(optarg, 0, 10); break;
+			case 'p': maxdepth = (int)strtoul(optarg, 0, 10); break;
+			case 'i': index_depth = (int)strtoul(optarg, 0, 10); break;
+			case 's': seed = (unsigned int)strtoul(optarg, 0, 10); break;
+			case 'b': batch = true; break;
+			case 'e': engine_names.push_back(optarg); break;
+			case 'h': usage(progname, 0); break;
+			default:  usage(progname, 1); break;
+		}
+	}
+
+	argc -= optind;
+	argv += optind;
+
+	std::string datafile = argc > 0 ? argv[0] : DATADIR "/" DEFAULT_LOCALE ".txt";
+
+	std::vector<std::string> names;
+	NameCollector(datafile, names).Parse();
+
+	if (names.empty()) {
+		std::cerr << "No names in " << datafile << std::endl;
+		return 1;
+	}
+
+	/* queries have 1..maxdepth edits, evenly distributed */
+	std::mt19937 rng(seed);
+	std::vector<std::string> queries;
+	for (int i = 0; i < count; i++) {
+		const std::string& name = names[std::uniform_int_distribution<size_t>(0, names.size() - 1)(rng)];
+		queries.push_back(Misspell(name, 1 + i % std::max(maxdepth, 1), rng));
+	}
+
+	std::vector<int> depths;
+	for (int depth = 0; depth <= maxdepth; depth++)
+		depths.push_back(depth);
+
+	fprintf(stdout, "%-10s %5s %9s %9s %11s %11s %11s\n", "engine", "depth", "build, s", "RSS, MB", "p50, us", "p99, us", "mean, us");
+	fflush(stdout);
+
+	for (size_t i = 0; i < sizeof(engines)/sizeof(engines[0]); i++) {
+		if (!engine_names.empty() && std::find(engine_names.begin(), engine_names.end(), engines[i].name) == engine_names.end())
+			continue;
+
+		pid_t pid = fork();
+		if (pid == -1) {
+			perror("fork");
+			return 1;
+		} else if (pid == 0) {
+			RunEngine(engines[i], datafile, queries, depths, index_depth, batch);
+			_exit(0);
+		}
+
+		int status;
+		if (waitpid(pid, &status, 0) == -1 || !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+			std::cerr << "Benchmark for " << engines[i].name << " failed" << std::endl;
+			return 1;
+		}
+	}
+
+	return 0;
+}
+
+int main(int argc, char** argv) {
+	try {
+		return realmain(argc, argv);
+	} catch(std::exception& e) {
+		std::cerr << "Caught error: " << e.what() << std::endl;
+	} catch(...) {
+		std::cerr << "Unknown error caught" << std::endl;
+	}
+
+	return 1;
+}
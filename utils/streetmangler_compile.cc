@@ -0,0 +1,104 @@
+/*
+ * Copyright (C) 2011-2013 Dmitry Marakasov
+ *
+ * This file is part of streetmangler.
+ *
+ * streetmangler is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * streetmangler is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with streetmangler.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <vector>
+#include <string>
+#include <cstdlib>
+#include <iostream>
+#include <exception>
+
+#include <getopt.h>
+
+#include <streetmangler/locale.hh>
+#include <streetmangler/database.hh>
+
+#ifndef DATADIR
+#	define DATADIR "."
+#endif
+
+#ifndef DEFAULT_LOCALE
+#	define DEFAULT_LOCALE "ru_RU"
+#endif
+
+int usage(const char* progname, int exitcode) {
+	std::cerr << "Usage: " << progname << " [-h] [-l locale] output.db [database.txt ...]" << std::endl;
+	std::cerr << "  -l  set locale (default \"" DEFAULT_LOCALE "\")" << std::endl << std::endl;
+
+	std::cerr << "  Compiles street names databases (default " DATADIR "/<locale>.txt)" << std::endl;
+	std::cerr << "  into binary image, which is loaded with Database::LoadCompiled" << std::endl << std::endl;
+
+	std::cerr << "  -h  display this help" << std::endl;
+
+	exit(exitcode);
+}
+
+int realmain(int argc, char** argv) {
+	const char* progname = argv[0];
+	const char* localename = DEFAULT_LOCALE;
+
+	int c;
+	while ((c = getopt(argc, argv, "hl:")) != -1) {
+		switch (c) {
+			case 'l': localename = optarg; break;
+			case 'h': usage(progname, 0); break;
+			default:  usage(progname, 1); break;
+		}
+	}
+
+	argc -= optind;
+	argv += optind;
+
+	if (argc < 1)
+		usage(progname, 1);
+
+	std::string output = argv[0];
+
+	std::vector<std::string> datafiles(argv + 1, argv + argc);
+	if (datafiles.empty()) {
+		std::string default_database = DATADIR "/";
+		default_database += localename;
+		default_database += ".txt";
+		datafiles.push_back(default_database);
+	}
+
+	StreetMangler::Locale locale(localename);
+	StreetMangler::Database database(locale);
+
+	for (std::vector<std::string>::const_iterator i = datafiles.begin(); i != datafiles.end(); ++i) {
+		std::cerr << "Loading dictionary \"" << *i << "\"..." << std::endl;
+		database.Load(*i);
+	}
+
+	std::cerr << "Writing \"" << output << "\"..." << std::endl;
+	database.WriteCompiled(output);
+
+	return 0;
+}
+
+int main(int argc, char** argv) {
+	try {
+		return realmain(argc, argv);
+	} catch(std::exception& e) {
+		std::cerr << "Caught error: " << e.what() << std::endl;
+	} catch(...) {
+		std::cerr << "Unknown error caught" << std::endl;
+	}
+
+	return 1;
+}